@@ -0,0 +1,63 @@
+#include <beatmap.h>
+
+static uint16_t readVarint(PGM_P* next) {
+    uint16_t value = 0;
+    uint8_t shift = 0;
+    uint8_t byte;
+    do {
+        byte = pgm_read_byte((*next)++);
+        value |= (uint16_t)(byte & 0x7F) << shift;
+        shift += 7;
+    } while ((byte & 0x80) && shift < 21);
+    return value;
+}
+
+/* Reads the record after the event just taken */
+static void loadRecord(BeatmapReader* reader) {
+    uint16_t delta = readVarint(&reader->next);
+    reader->event = pgm_read_byte(reader->next++);
+    reader->wait = delta >> 1;
+    reader->repeats = 0;
+    if (reader->event != BEATMAP_END && (delta & 0x01)) {
+        reader->repeats = readVarint(&reader->next);
+        reader->period = readVarint(&reader->next);
+    }
+}
+
+uint8_t beatmapOpen(BeatmapReader* reader, PGM_P map) {
+    reader->tick = 0;
+    if (pgm_read_byte(map) != BEATMAP_MAGIC_0 || pgm_read_byte(map + 1) != BEATMAP_MAGIC_1
+        || pgm_read_byte(map + 2) != BEATMAP_VERSION) {
+        beatmapStop(reader);
+        return 0;
+    }
+    reader->tick_ms = pgm_read_word(map + 3);  /* little endian, like the AVR */
+    reader->next = map + BEATMAP_HEADER_SIZE;
+    loadRecord(reader);
+    return 1;
+}
+
+void beatmapStop(BeatmapReader* reader) {
+    reader->event = BEATMAP_END;
+    reader->wait = 0;
+    reader->repeats = 0;
+}
+
+uint8_t beatmapNextEvent(BeatmapReader* reader, uint8_t* event) {
+    if (reader->wait != 0 || reader->event == BEATMAP_END) return 0;
+
+    *event = reader->event;
+    if (reader->repeats != 0) {
+        reader->repeats--;
+        reader->wait = reader->period;
+    } else {
+        loadRecord(reader);
+    }
+    return 1;
+}
+
+void beatmapTick(BeatmapReader* reader) {
+    if (reader->event == BEATMAP_END) return;
+    reader->tick++;
+    if (reader->wait != 0) reader->wait--;
+}
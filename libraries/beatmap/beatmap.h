@@ -0,0 +1,42 @@
+/* Streaming beatmap reader.
+
+   Reads a beatmap (see beatmap_format.h) straight from flash, one record at
+   a time: nothing is copied to SRAM, and each event costs a few byte reads
+   when it is taken. The reader is a small cursor, so the map can be as long
+   as the flash left next to the firmware.
+
+   Once per game tick:
+     uint8_t event;
+     while (beatmapNextEvent(&reader, &event)) { ...spawn it... }
+     beatmapTick(&reader);
+ */
+#ifndef BEATMAP_H
+#define BEATMAP_H
+
+#include <stdint.h>
+#include <avr/pgmspace.h>
+#include "beatmap_format.h"
+
+typedef struct {
+    PGM_P next;        /* first unread byte of the map */
+    uint16_t wait;     /* ticks until the pending event is due */
+    uint16_t repeats;  /* times the pending event comes again after this one */
+    uint16_t period;   /* ticks between those repeats */
+    uint16_t tick;     /* ticks played so far */
+    uint16_t tick_ms;  /* tick length the map was made for */
+    uint8_t event;     /* pending event, BEATMAP_END once the map is over */
+} BeatmapReader;
+
+/* Starts reading a PROGMEM beatmap. Returns 0, with the reader ended, if it isn't one. */
+uint8_t beatmapOpen(BeatmapReader* reader, PGM_P map);
+void beatmapStop(BeatmapReader* reader);
+
+/* Takes the next event due in this tick; 0 when the rest is for later ticks */
+uint8_t beatmapNextEvent(BeatmapReader* reader, uint8_t* event);
+void beatmapTick(BeatmapReader* reader);
+
+static inline uint8_t beatmapEnded(const BeatmapReader* reader) {
+    return reader->event == BEATMAP_END;
+}
+
+#endif
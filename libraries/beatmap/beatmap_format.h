@@ -0,0 +1,47 @@
+/* Beatmap format, shared by the firmware and the host tools.
+
+   A beatmap is a byte string in flash:
+
+     header   'B', 'M', version, tick_ms (u16, little endian)
+     records  delta, event [, count, period]   ... up to the END event
+
+   delta    varint: (ticks since the previous event << 1) | run flag
+   event    one byte, see BEATMAP_EVENT(); BEATMAP_END ends the map
+   run      with the run flag set, the event comes count more times,
+            period ticks apart; count and period are varints
+
+   Varints are little-endian base 128: 7 bits per byte, the high bit is set
+   on every byte but the last. Times count game ticks of tick_ms, so a map
+   plays at one fixed tempo. A typical record is two bytes, and a run of
+   identical events costs four bytes however long it is.
+ */
+#ifndef BEATMAP_FORMAT_H
+#define BEATMAP_FORMAT_H
+
+#define BEATMAP_MAGIC_0 'B'
+#define BEATMAP_MAGIC_1 'M'
+#define BEATMAP_VERSION 1
+#define BEATMAP_HEADER_SIZE 5
+#define BEATMAP_MAX_DELTA 0x7FFF  /* ticks; the shifted delta must fit 16 bits */
+#define BEATMAP_MAX_RUN 0xFFFF    /* count and period of a run; the reader keeps 16 bits */
+
+/* Event byte: position in bits 0-2, kind in bits 3-4, slow in bit 5, drift in bits 6-7 */
+#define BEATMAP_EVENT(position, kind, slow, drift) \
+    ((position) | ((kind) << 3) | ((slow) << 5) | ((drift) << 6))
+#define BEATMAP_POSITION(event) ((event) & 0x07)
+#define BEATMAP_KIND(event) (((event) >> 3) & 0x03)
+#define BEATMAP_SLOW(event) (((event) >> 5) & 0x01)  /* half speed */
+#define BEATMAP_DRIFT(event) ((event) >> 6)
+
+#define BEATMAP_BLOCK 0    /* one cell */
+#define BEATMAP_WALL 1     /* three cells, upwards from position */
+#define BEATMAP_WALL_MAX_POSITION 5  /* the whole wall on screen; walls never drift */
+#define BEATMAP_POWERUP 2  /* restores a life */
+
+#define BEATMAP_DRIFT_NONE 0
+#define BEATMAP_DRIFT_DOWN 1  /* position grows every tick */
+#define BEATMAP_DRIFT_UP 2    /* position shrinks every tick */
+
+#define BEATMAP_END 0xFF  /* kind 3 is not an obstacle */
+
+#endif
@@ -0,0 +1,137 @@
+#include <beatstream.h>
+
+typedef struct {
+    uint16_t tick;
+    uint8_t event;
+} StreamEvent;
+
+/* Banks are filled whole by one record and emptied in order */
+static StreamEvent banks[BEATSTREAM_BANKS][BEATSTREAM_BANK_EVENTS];
+static uint8_t bank_size[BEATSTREAM_BANKS];
+static uint8_t read_bank = 0;   /* bank the game takes events from */
+static uint8_t read_index = 0;
+static uint8_t write_bank = 0;  /* bank the next EVENTS record goes into */
+static uint8_t full_banks = 0;
+
+static BeatstreamStatus status;
+static uint16_t tick_ms = 0;
+
+void beatstreamReset(void) {
+    read_bank = 0;
+    read_index = 0;
+    write_bank = 0;
+    full_banks = 0;
+    tick_ms = 0;
+    status.flags = 0;
+    status.next_seq = 0;
+    status.tick = 0;
+    status.underruns = 0;
+    status.late = 0;
+    status.rejected = 0;
+}
+
+static uint16_t getU16(const uint8_t* in) {
+    return in[0] | (in[1] << 8);
+}
+
+static uint8_t receiveEvents(const uint8_t* payload, uint8_t length) {
+    uint8_t count = payload[1];
+    if (count == 0 || count > BEATSTREAM_BANK_EVENTS
+        || length != BEATSTREAM_EVENTS_HEADER + count * BEATSTREAM_EVENT_SIZE) {
+        return 0;
+    }
+    if (payload[0] != status.next_seq || full_banks == BEATSTREAM_BANKS
+        || (status.flags & BEATSTREAM_END_SEEN)) {
+        return 0;  /* a resend of an old record, or one sent without credit */
+    }
+
+    const uint8_t* in = payload + BEATSTREAM_EVENTS_HEADER;
+    for (uint8_t i = 0; i < count; i++, in += BEATSTREAM_EVENT_SIZE) {
+        banks[write_bank][i].tick = getU16(in);
+        banks[write_bank][i].event = in[2];
+    }
+    bank_size[write_bank] = count;
+    write_bank = (write_bank + 1) % BEATSTREAM_BANKS;
+    full_banks++;
+    status.next_seq++;
+    return 1;
+}
+
+uint8_t beatstreamReceive(const uint8_t* record, uint8_t length) {
+    if (length == 0) return 0;
+
+    const uint8_t* payload = record + 1;
+    uint8_t size = length - 1;
+    uint8_t accepted = 0;
+    switch (record[0]) {
+        case BEATSTREAM_START:
+            if (size != BEATSTREAM_START_SIZE) break;
+            beatstreamReset();
+            tick_ms = getU16(payload);
+            status.flags = BEATSTREAM_STARTED;
+            accepted = 1;
+            break;
+        case BEATSTREAM_EVENTS:
+            accepted = (status.flags & BEATSTREAM_STARTED) && size >= BEATSTREAM_EVENTS_HEADER
+                       && receiveEvents(payload, size);
+            break;
+        case BEATSTREAM_END:
+            if (size != BEATSTREAM_END_SIZE || !(status.flags & BEATSTREAM_STARTED)) break;
+            if (payload[0] == status.next_seq && !(status.flags & BEATSTREAM_END_SEEN)) {
+                status.flags |= BEATSTREAM_END_SEEN;
+                status.next_seq++;
+                accepted = 1;
+            }
+            break;
+        default:
+            return 0;
+    }
+    if (!accepted) status.rejected++;
+    return 1;
+}
+
+uint8_t beatstreamStarted(void) {
+    return status.flags & BEATSTREAM_STARTED;
+}
+
+uint16_t beatstreamTickMs(void) {
+    return tick_ms;
+}
+
+uint8_t beatstreamFinished(void) {
+    return (status.flags & BEATSTREAM_END_SEEN) && full_banks == 0;
+}
+
+uint8_t beatstreamNextEvent(uint8_t* event) {
+    while (full_banks != 0) {
+        StreamEvent* next = &banks[read_bank][read_index];
+        if (next->tick > status.tick) return 0;
+
+        uint8_t taken = next->event;
+        uint8_t late = next->tick < status.tick;
+        if (++read_index == bank_size[read_bank]) {
+            read_index = 0;
+            read_bank = (read_bank + 1) % BEATSTREAM_BANKS;
+            full_banks--;  /* one more credit for the host */
+        }
+        if (late) {
+            status.late++;
+            continue;
+        }
+        *event = taken;
+        return 1;
+    }
+    return 0;
+}
+
+void beatstreamTick(void) {
+    if (!(status.flags & BEATSTREAM_STARTED)) return;
+    if (full_banks == 0 && !(status.flags & BEATSTREAM_END_SEEN)) status.underruns++;
+    status.tick++;
+}
+
+void beatstreamGetStatus(BeatstreamStatus* out) {
+    *out = status;
+    out->credits = BEATSTREAM_BANKS - full_banks;
+    if (beatstreamFinished()) out->flags |= BEATSTREAM_FINISHED;
+}
@@ -0,0 +1,52 @@
+/* Beatmap events streamed from the host (see beatstream_protocol.h).
+
+   Records come in through beatstreamReceive() and fill a double-buffered
+   queue: the game takes events from one bank while the host refills the
+   other, so a host that stalls for less than two banks of events costs
+   nothing. The game's tick clock never waits for the host; ticks that find
+   the queue empty are counted as underruns, and events that arrive after
+   their tick are dropped and counted as late.
+
+   Everything runs in the main loop. No AVR headers are used, so the host
+   board stand-in (tools/board_sim) builds the same file.
+ */
+#ifndef BEATSTREAM_H
+#define BEATSTREAM_H
+
+#include <stdint.h>
+#include "beatstream_protocol.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+    uint8_t flags;       /* BEATSTREAM_STARTED, ... */
+    uint8_t next_seq;    /* sequence number of the next EVENTS or END record */
+    uint8_t credits;     /* free banks */
+    uint16_t tick;       /* game ticks since START */
+    uint16_t underruns;  /* ticks that found the queue empty before END */
+    uint16_t late;       /* events dropped because their tick had passed */
+    uint16_t rejected;   /* records dropped: no credit, out of sequence or malformed */
+} BeatstreamStatus;
+
+void beatstreamReset(void);
+
+/* Takes a record; returns 0 if it is not a stream record */
+uint8_t beatstreamReceive(const uint8_t* record, uint8_t length);
+
+uint8_t beatstreamStarted(void);
+uint16_t beatstreamTickMs(void);
+uint8_t beatstreamFinished(void);
+
+/* Once per game tick: take the events due, then call beatstreamTick() */
+uint8_t beatstreamNextEvent(uint8_t* event);
+void beatstreamTick(void);
+
+void beatstreamGetStatus(BeatstreamStatus* status);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,49 @@
+/* Beatmap streaming protocol, shared by the firmware and the host tools.
+
+   Host to device: frames framed like telemetry (0x00, COBS(record + crc), 0x00,
+   see telemetry_protocol.h), but a record is only type and payload. The
+   console picks them out of the command input.
+
+   Device to host: TELEMETRY_STREAM records, sent after every stream record
+   and every game tick that takes events from the stream.
+
+   Flow control is credit based. The device queues events in BEATSTREAM_BANKS
+   banks of up to BEATSTREAM_BANK_EVENTS events; one EVENTS record fills one
+   bank. Every status report carries the number of free banks (credits) and
+   the sequence number expected next, so the host never has more records in
+   flight than it has credits. A record that comes without credit or out of
+   sequence is dropped, and the host resends from next_seq.
+
+   Event ticks are absolute game ticks from the START record, so an event
+   that arrives after its tick is dropped as late instead of shifting
+   every later one.
+
+   A stream plays one game. When that game ends, finished or lost, the
+   device forgets the stream and reports that with STARTED clear; the next
+   game takes a stream only after a new START.
+ */
+#ifndef BEATSTREAM_PROTOCOL_H
+#define BEATSTREAM_PROTOCOL_H
+
+#define BEATSTREAM_BANKS 2
+#define BEATSTREAM_BANK_EVENTS 8
+
+/* Record types and payload layouts */
+#define BEATSTREAM_START 0x81    /* forget queued events, restart at tick 0 */
+#define BEATSTREAM_START_SIZE 2  /* tick_ms u16 */
+
+#define BEATSTREAM_EVENTS 0x82   /* seq u8, count u8, count x (tick u16, event u8) */
+#define BEATSTREAM_EVENTS_HEADER 2
+#define BEATSTREAM_EVENT_SIZE 3  /* event: a beatmap event byte, see beatmap_format.h */
+
+#define BEATSTREAM_END 0x83      /* nothing follows the events before seq */
+#define BEATSTREAM_END_SIZE 1    /* seq u8 */
+
+#define BEATSTREAM_MAX_RECORD (1 + BEATSTREAM_EVENTS_HEADER + BEATSTREAM_BANK_EVENTS * BEATSTREAM_EVENT_SIZE)
+
+/* Flags of the status report */
+#define BEATSTREAM_STARTED 0x01   /* a START record came in (since the last stream game ended) */
+#define BEATSTREAM_END_SEEN 0x02  /* the END record came in */
+#define BEATSTREAM_FINISHED 0x04  /* ... and every event has been taken */
+
+#endif
@@ -1,5 +1,7 @@
 #include <avr/io.h>
 #include <avr/interrupt.h> //so you can do the whole interrupts/ISR() stuff
+#include <util/atomic.h>
+#include "button.h"
 
 // For buttons, you want the pin to receive input, so you do DDRC &= ~
 // Unlike with LEDs, we want to set the corresponding bit to 0, making that pin ready for INPUT (not output, like with the LEDs) 
@@ -58,4 +60,103 @@ void enableAllButtonInterrupts() {
     PCMSK1 |= _BV(PC1);                //Enble intterupt for all three buttons
     PCMSK1 |= _BV(PC2);
     PCMSK1 |= _BV(PC3);
-}
\ No newline at end of file
+}
+
+// Debounced buttons - see button.h
+#define BUTTON_PIN_MASK (_BV(PC1) | _BV(PC2) | _BV(PC3))  // PC0 is the potentiometer
+#define HOLD_SAMPLES (BUTTON_HOLD_DELAY / BUTTON_SAMPLE_PERIOD)
+#define REPEAT_SAMPLES (BUTTON_REPEAT_PERIOD / BUTTON_SAMPLE_PERIOD)
+#define QUEUE_MASK (BUTTON_QUEUE_SIZE - 1)
+
+static uint8_t debounced = 0;                // bit n set = button on PCn is down
+static uint8_t count0 = 0xFF, count1 = 0xFF;  // vertical counters, one bit pair per pin
+static uint8_t held_samples[BUTTON_COUNT];   // samples since the press, while held
+
+static ButtonEvent queue[BUTTON_QUEUE_SIZE];
+static volatile uint8_t queue_head = 0;  // written by buttonPushEvent()
+static volatile uint8_t queue_tail = 0;  // written by buttonGetEvent()
+static volatile uint8_t events_dropped = 0;
+
+void initButtons(void) {
+    for (uint8_t button = 1; button <= BUTTON_COUNT; button++) {
+        enableButton(button);
+    }
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        debounced = 0;
+        count0 = 0xFF;
+        count1 = 0xFF;
+        queue_head = queue_tail = 0;
+        events_dropped = 0;
+        for (uint8_t i = 0; i < BUTTON_COUNT; i++) {
+            held_samples[i] = 0;
+        }
+    }
+}
+
+void buttonPushEvent(uint8_t button, uint8_t kind, uint16_t time) {
+    // Called from the timer interrupt and from the main loop (injected events)
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        uint8_t next = (queue_head + 1) & QUEUE_MASK;
+        if (next == queue_tail) {
+            if (events_dropped < 0xFF) events_dropped++;
+        } else {
+            queue[queue_head].button = button;
+            queue[queue_head].kind = kind;
+            queue[queue_head].time = time;
+            queue_head = next;
+        }
+    }
+}
+
+uint8_t buttonGetEvent(ButtonEvent* event) {
+    uint8_t tail = queue_tail;
+    if (tail == queue_head) return 0;
+    *event = queue[tail];
+    queue_tail = (tail + 1) & QUEUE_MASK;
+    return 1;
+}
+
+void buttonClearEvents(void) {
+    queue_tail = queue_head;
+}
+
+uint8_t buttonEventPending(void) {
+    return queue_tail != queue_head;
+}
+
+uint8_t buttonIsDown(uint8_t button) {
+    if (button < 1 || button > BUTTON_COUNT) return 0;
+    return (debounced >> (PC1 + button - 1)) & 1;
+}
+
+uint8_t buttonEventsDropped(void) {
+    return events_dropped;
+}
+
+void buttonSample(uint16_t time) {
+    // All pins at once: a pin whose sample differs from its debounced state
+    // counts 3, 2, 1, 0 and toggles on the 4th sample; any sample that agrees
+    // resets its counter to 3.
+    uint8_t changed = debounced ^ (~PINC & BUTTON_PIN_MASK);
+    count0 = ~(count0 & changed);
+    count1 = count0 ^ (count1 & changed);
+    changed &= count0 & count1;
+    debounced ^= changed;
+
+    for (uint8_t button = 1; button <= BUTTON_COUNT; button++) {
+        uint8_t bit = _BV(PC1 + button - 1);
+        uint8_t* held = &held_samples[button - 1];
+
+        if (changed & bit) {
+            buttonPushEvent(button, (debounced & bit) ? BUTTON_PRESS : BUTTON_RELEASE, time);
+            *held = 0;
+        } else if (debounced & bit) {
+            if (++*held == HOLD_SAMPLES) {
+                buttonPushEvent(button, BUTTON_HOLD, time);
+            } else if (*held == HOLD_SAMPLES + REPEAT_SAMPLES) {
+                buttonPushEvent(button, BUTTON_REPEAT, time);
+                *held = HOLD_SAMPLES;
+            }
+        }
+    }
+}
@@ -1,7 +1,61 @@
 //Basic functions for the buttons on your Arduino Uno
+#ifndef BUTTON_H
+#define BUTTON_H
+
+#include <stdint.h>
+
 void enableButton( int button );
 int buttonPushed( int button );
 int buttonReleased( int button );
 
 void enableButtonInterrupt(int button);
 void enableAllButtonInterrupts(void);
+
+/* Debounced buttons with an event queue.
+
+   buttonSample() is called from the timer interrupt every BUTTON_SAMPLE_PERIOD
+   ms. It debounces buttons 1-3 (PC1-PC3) together with 2-bit vertical
+   counters: a pin has to read the same for 4 samples in a row (20 ms) before
+   its state changes. Each change, and a button held down, queues an event
+   that the main loop takes with buttonGetEvent() - no caller waits to debounce.
+ */
+#define BUTTON_COUNT 3
+#define BUTTON_SAMPLE_PERIOD 5    // ms between samples
+#define BUTTON_HOLD_DELAY 500     // ms held down before BUTTON_HOLD
+#define BUTTON_REPEAT_PERIOD 150  // ms between BUTTON_REPEAT events after that
+
+/* The queue size must be a power of two, at most 256 */
+#ifndef BUTTON_QUEUE_SIZE
+#define BUTTON_QUEUE_SIZE 8
+#endif
+
+/* Event kinds */
+#define BUTTON_PRESS 0
+#define BUTTON_RELEASE 1
+#define BUTTON_HOLD 2    // once, BUTTON_HOLD_DELAY after the press
+#define BUTTON_REPEAT 3  // then every BUTTON_REPEAT_PERIOD until released
+
+typedef struct {
+    uint8_t button;  // 1-3, as for enableButton()
+    uint8_t kind;
+    uint16_t time;   // the time passed to buttonSample(), in ms
+} ButtonEvent;
+
+void initButtons(void);
+/* Enables buttons 1-3 with pull-ups and empties the queue */
+void buttonSample(uint16_t time);
+/* Call every BUTTON_SAMPLE_PERIOD ms from the timer interrupt */
+uint8_t buttonGetEvent(ButtonEvent* event);
+/* Takes the oldest event; returns 0 when the queue is empty */
+void buttonPushEvent(uint8_t button, uint8_t kind, uint16_t time);
+/* Queues an event as if the button had done it (serial commands, replays) */
+void buttonClearEvents(void);
+/* Drops every queued event */
+uint8_t buttonEventPending(void);
+/* 1 while an event is queued; cheap enough to test with interrupts off */
+uint8_t buttonIsDown(uint8_t button);
+/* Debounced state of a button */
+uint8_t buttonEventsDropped(void);
+/* Events lost because the queue was full */
+
+#endif
@@ -1,37 +1,171 @@
 #include <avr/io.h>
-#include <usart.h>
-#define __DELAY_BACKWARD_COMPATIBLE__
-#include <util/delay.h>
-#include "buzzer.h"
+#include <avr/pgmspace.h>
+#include <util/atomic.h>
 #include <stdint.h>
+#include "buzzer.h"
+
+/* Timer2 in CTC mode toggles OC2B at every compare match, so the tone is
+   F_CPU / (2 * prescaler * (counts + 1)). The smallest prescaler that keeps
+   counts within 8 bits gives the best pitch; every note is within 0.5%. */
+#define TONE_COUNTS(centihz, prescaler) \
+    ((F_CPU * 100UL + (prescaler) * (centihz)) / (2UL * (prescaler) * (centihz)) - 1)
+#define TONE_FITS(centihz, prescaler) (TONE_COUNTS(centihz, prescaler) <= 255)
+#define TONE_PRESCALER(centihz) \
+    (TONE_FITS(centihz, 8) ? 8 : TONE_FITS(centihz, 32) ? 32 : TONE_FITS(centihz, 64) ? 64 : \
+     TONE_FITS(centihz, 128) ? 128 : TONE_FITS(centihz, 256) ? 256 : 1024)
+#define TONE_CLOCK_SELECT(centihz) \
+    (TONE_FITS(centihz, 8) ? 2 : TONE_FITS(centihz, 32) ? 3 : TONE_FITS(centihz, 64) ? 4 : \
+     TONE_FITS(centihz, 128) ? 5 : TONE_FITS(centihz, 256) ? 6 : 7)
+#define TONE(centihz) { TONE_CLOCK_SELECT(centihz), TONE_COUNTS(centihz, TONE_PRESCALER(centihz)) }
+
+typedef struct {
+    uint8_t clock_select;  // TCCR2B CS22:0
+    uint8_t counts;        // OCR2A
+} Tone;
+
+// Indexed by NOTE_xx - 1; frequencies in 1/100 Hz (equal temperament, A4 = 440 Hz)
+static const Tone TONES[] PROGMEM = {
+    TONE(26163),  // C4, 261.63 Hz
+    TONE(27718),  // CS4, 277.18 Hz
+    TONE(29366),  // D4, 293.66 Hz
+    TONE(31113),  // DS4, 311.13 Hz
+    TONE(32963),  // E4, 329.63 Hz
+    TONE(34923),  // F4, 349.23 Hz
+    TONE(36999),  // FS4, 369.99 Hz
+    TONE(39200),  // G4, 392.00 Hz
+    TONE(41530),  // GS4, 415.30 Hz
+    TONE(44000),  // A4, 440.00 Hz
+    TONE(46616),  // AS4, 466.16 Hz
+    TONE(49388),  // B4, 493.88 Hz
+    TONE(52325),  // C5, 523.25 Hz
+    TONE(55437),  // CS5, 554.37 Hz
+    TONE(58733),  // D5, 587.33 Hz
+    TONE(62225),  // DS5, 622.25 Hz
+    TONE(65926),  // E5, 659.26 Hz
+    TONE(69846),  // F5, 698.46 Hz
+    TONE(73999),  // FS5, 739.99 Hz
+    TONE(78399),  // G5, 783.99 Hz
+    TONE(83061),  // GS5, 830.61 Hz
+    TONE(88000),  // A5, 880.00 Hz
+    TONE(93233),  // AS5, 932.33 Hz
+    TONE(98777),  // B5, 987.77 Hz
+    TONE(104650),  // C6, 1046.50 Hz
+    TONE(110873),  // CS6, 1108.73 Hz
+    TONE(117466),  // D6, 1174.66 Hz
+    TONE(124451),  // DS6, 1244.51 Hz
+    TONE(131851),  // E6, 1318.51 Hz
+    TONE(139691),  // F6, 1396.91 Hz
+    TONE(147998),  // FS6, 1479.98 Hz
+    TONE(156798),  // G6, 1567.98 Hz
+    TONE(166122),  // GS6, 1661.22 Hz
+    TONE(176000),  // A6, 1760.00 Hz
+    TONE(186466),  // AS6, 1864.66 Hz
+    TONE(197553),  // B6, 1975.53 Hz
+    TONE(209300),  // C7, 2093.00 Hz
+};
 
-//DURATION IS IN MILLISECONDS
-#define DURATION 150
+#define QUEUE_MASK (BUZZER_QUEUE_SIZE - 1)
 
-//FREQUENCIES OF THE NOTES
-#define C5 523.250
-#define D5 587.330
-#define E5 659.250
-#define F5 698.460
-#define G5 783.990
-#define A5 880.00
-#define B5 987.770
-#define C6 1046.500
+static Note queue[BUZZER_QUEUE_SIZE];
+static volatile uint8_t queue_head = 0;  // written by the main program
+static volatile uint8_t queue_tail = 0;  // written by buzzerTick()
+
+static uint8_t ticks_left = 0;   // of the current note or rest
+static uint8_t rest_after = 0;   // silence still to come after the current note
+
+static void toneOff(void) {
+    TCCR2B = 0;                // stop the clock
+    TCCR2A = 0;                // give PD3 back to PORTD: idle high
+}
+
+static void toneOn(uint8_t note) {
+    uint8_t index = note - 1;
+    if (note == NOTE_REST || index >= sizeof(TONES) / sizeof(TONES[0])) {
+        toneOff();
+        return;
+    }
+    TCCR2B = 0;
+    TCNT2 = 0;
+    OCR2A = pgm_read_byte(&TONES[index].counts);
+    OCR2B = 0;
+    TCCR2A = (1 << COM2B0) | (1 << WGM21);  // toggle OC2B on compare match, CTC
+    TCCR2B = pgm_read_byte(&TONES[index].clock_select);
+}
 
 void enableBuzzer()
 {
+   toneOff();
+   PORTD |= ( 1 << PD3 ); //Idle high: the buzzer is off
    DDRD |= ( 1 << PD3 ); //Buzzer is connected to PD3
 }
 
-void playTone( float frequency, uint32_t duration )
-{
-   uint32_t periodInMicro = ( uint32_t ) ( 1000000 / frequency ); //Calculate the period in microsecs from the freq
-   uint32_t durationInMicro = duration * 1000; //We express duration in microsecs
-   for ( uint32_t time = 0; time < durationInMicro; time += periodInMicro ) //See tutorial on Music for more info!
-    {
-    PORTD &= ~( 1 << PD3 ); //turn the buzzer on
-    _delay_us( periodInMicro / 2 ); //Wait for the half of the period
-    PORTD |= ( 1 << PD3 ); //Turn the buzzer off
-    _delay_us( periodInMicro / 2 ); //Wait again for half of the period
+void buzzerTick(void) {
+    if (ticks_left > 0 && --ticks_left > 0) return;
+
+    if (rest_after > 0) {
+        toneOff();
+        ticks_left = rest_after;
+        rest_after = 0;
+        return;
     }
-}
\ No newline at end of file
+
+    uint8_t tail = queue_tail;
+    if (tail == queue_head) {
+        toneOff();
+        return;
+    }
+    Note* next = &queue[tail];
+    toneOn(next->note);
+    ticks_left = next->duration;
+    rest_after = next->rest;
+    queue_tail = (tail + 1) & QUEUE_MASK;
+}
+
+static uint8_t queueFree(void) {
+    return (queue_tail - queue_head - 1) & QUEUE_MASK;
+}
+
+static void queueNote(uint8_t note, uint8_t duration, uint8_t rest) {
+    uint8_t head = queue_head;
+    queue[head].note = note;
+    queue[head].duration = duration;
+    queue[head].rest = rest;
+    queue_head = (head + 1) & QUEUE_MASK;  // published after the note is complete
+}
+
+uint8_t playNote(uint8_t note, uint8_t duration, uint8_t rest) {
+    if (queueFree() == 0 || duration == 0) return 0;
+    queueNote(note, duration, rest);
+    return 1;
+}
+
+uint8_t playMelody(const Note* melody) {
+    uint8_t length = 0;
+    while (pgm_read_byte(&melody[length].note) != NOTE_END) {
+        length++;
+    }
+    if (length > queueFree()) return 0;
+
+    for (uint8_t i = 0; i < length; i++) {
+        queueNote(pgm_read_byte(&melody[i].note), pgm_read_byte(&melody[i].duration),
+                  pgm_read_byte(&melody[i].rest));
+    }
+    return 1;
+}
+
+void stopSound(void) {
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        queue_tail = queue_head;
+        ticks_left = 0;
+        rest_after = 0;
+        toneOff();
+    }
+}
+
+uint8_t soundPlaying(void) {
+    uint8_t playing;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        playing = ticks_left > 0 || rest_after > 0 || queue_tail != queue_head;
+    }
+    return playing;
+}
@@ -1,2 +1,52 @@
+#ifndef BUZZER_H
+#define BUZZER_H
+
+#include <stdint.h>
+
+/* Tones are made in hardware: the buzzer sits on PD3, which is OC2B, and
+   Timer2 in CTC mode toggles it every OCR2A+1 counts. Each note's prescaler
+   and compare value are worked out at compile time (see buzzer.c), so
+   starting a note is three register writes and the CPU never waits.
+
+   Notes are queued with their duration and the silence after them.
+   buzzerTick(), called every BUZZER_TICK ms from the timer interrupt, moves
+   the queue on. */
+#define BUZZER_TICK 10  // ms; note durations and rests are in these units
+
+/* The queue size must be a power of two, at most 256. playMelody() needs room
+   for the whole melody. */
+#ifndef BUZZER_QUEUE_SIZE
+#define BUZZER_QUEUE_SIZE 16
+#endif
+
+/* Chromatic notes C4 (262 Hz) to C7 (2093 Hz) */
+enum {
+    NOTE_REST,  // silence for the duration
+    NOTE_C4, NOTE_CS4, NOTE_D4, NOTE_DS4, NOTE_E4, NOTE_F4, NOTE_FS4, NOTE_G4, NOTE_GS4, NOTE_A4, NOTE_AS4, NOTE_B4,
+    NOTE_C5, NOTE_CS5, NOTE_D5, NOTE_DS5, NOTE_E5, NOTE_F5, NOTE_FS5, NOTE_G5, NOTE_GS5, NOTE_A5, NOTE_AS5, NOTE_B5,
+    NOTE_C6, NOTE_CS6, NOTE_D6, NOTE_DS6, NOTE_E6, NOTE_F6, NOTE_FS6, NOTE_G6, NOTE_GS6, NOTE_A6, NOTE_AS6, NOTE_B6,
+    NOTE_C7,
+    NOTE_END = 0xFF  // ends a melody
+};
+
+typedef struct {
+    uint8_t note;      // NOTE_xx
+    uint8_t duration;  // BUZZER_TICK units
+    uint8_t rest;      // silence after the note, BUZZER_TICK units
+} Note;
+
 void enableBuzzer();
-void playTone( float frequency, uint32_t duration );
\ No newline at end of file
+/* PD3 as output (idle high), Timer2 stopped */
+void buzzerTick(void);
+/* Call every BUZZER_TICK ms from the timer interrupt */
+uint8_t playNote(uint8_t note, uint8_t duration, uint8_t rest);
+/* Queues one note; returns 0 if the queue is full */
+uint8_t playMelody(const Note* melody);
+/* Queues a PROGMEM array of notes ending with NOTE_END. All or nothing:
+   returns 0, and queues nothing, if it does not fit */
+void stopSound(void);
+/* Silences the buzzer and empties the queue */
+uint8_t soundPlaying(void);
+/* 1 while a note, a rest or a queued note is left */
+
+#endif
@@ -0,0 +1,32 @@
+/* Clock synchronization protocol, shared by the firmware and tools/conductor.
+
+   Host to device: records framed like the beatmap stream's (see
+   beatstream_protocol.h), type and payload.
+
+   Device to host: TELEMETRY_PONG and TELEMETRY_GAME_TICK records (see
+   telemetry_protocol.h). The device starts sending TELEMETRY_GAME_TICK, one
+   per game tick, after the first PING.
+
+   The host estimates the offset between its clock and the board's from the
+   PING/PONG round trips (keeping the fastest ones), and the drift from how
+   that offset moves. It cancels the drift with TRIM, which changes how many
+   Timer1 counts make one of the board's milliseconds, and keeps the game
+   ticks on the music with NUDGE.
+ */
+#ifndef CLOCKSYNC_PROTOCOL_H
+#define CLOCKSYNC_PROTOCOL_H
+
+#define CLOCKSYNC_COUNTS_PER_MS 2000  /* Timer1 counts (0.5 us) per millisecond at 16 MHz */
+
+/* Record types and payload layouts */
+#define CLOCKSYNC_PING 0x84      /* answered with TELEMETRY_PONG */
+#define CLOCKSYNC_PING_SIZE 5    /* seq u8, host_time u32 (host microseconds, echoed) */
+
+#define CLOCKSYNC_TRIM 0x85      /* counts added to every millisecond, in 1/256 counts */
+#define CLOCKSYNC_TRIM_SIZE 2    /* trim i16: 1 is 1.95 ppm, positive slows the board down */
+#define CLOCKSYNC_TRIM_MAX 10240 /* +-40 counts, 2% */
+
+#define CLOCKSYNC_NUDGE 0x86     /* move the next game tick */
+#define CLOCKSYNC_NUDGE_SIZE 2   /* shift i16 in ms, positive is later */
+
+#endif
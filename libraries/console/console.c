@@ -0,0 +1,150 @@
+#include <stdint.h>
+#include <string.h>
+#include <avr/pgmspace.h>
+#include <util/crc16.h>
+#include <usart.h>
+#include <telemetry_protocol.h>
+#include "console.h"
+
+static const ConsoleCommand* command_table = 0;
+static uint8_t command_count = 0;
+
+static char line[CONSOLE_LINE_LENGTH + 1];
+static uint8_t line_length = 0;
+static uint8_t line_overflow = 0;  // too long: ignore the rest of it
+
+static FrameHandler frame_handler = 0;
+static uint8_t frame[CONSOLE_FRAME_LENGTH];
+static uint8_t frame_length = 0;
+static uint8_t in_frame = 0;        // between the opening and the closing 0x00
+static uint8_t frame_overflow = 0;
+static uint16_t frames_rejected = 0;
+
+void initConsole(const ConsoleCommand* commands, uint8_t count) {
+    command_table = commands;
+    command_count = count;
+    line_length = 0;
+    line_overflow = 0;
+    in_frame = 0;
+}
+
+void consoleOnFrame(FrameHandler handler) {
+    frame_handler = handler;
+}
+
+uint16_t consoleFramesRejected(void) {
+    return frames_rejected;
+}
+
+// Decodes the COBS frame in place and checks its CRC; returns the record length or 0
+static uint8_t decodeFrame(void) {
+    uint8_t in = 0;
+    uint8_t out = 0;
+    while (in < frame_length) {
+        uint8_t code = frame[in++];
+        if (code == 0 || in + code - 1 > frame_length) return 0;
+        for (uint8_t k = 1; k < code; k++) {
+            frame[out++] = frame[in++];
+        }
+        if (code != 0xFF && in < frame_length) frame[out++] = 0;
+    }
+    if (out <= TELEMETRY_CRC_SIZE) return 0;
+
+    uint8_t length = out - TELEMETRY_CRC_SIZE;
+    uint16_t crc = TELEMETRY_CRC_INIT;
+    for (uint8_t i = 0; i < length; i++) {
+        crc = _crc_xmodem_update(crc, frame[i]);
+    }
+    if (crc != (frame[length] | (frame[length + 1] << 8))) return 0;
+    return length;
+}
+
+// A 0x00 opens a frame or, with bytes collected, closes it
+static void frameDelimiter(void) {
+    if (frame_length == 0) {
+        in_frame = 1;
+        frame_overflow = 0;
+        line_length = 0;  // whatever text came before is cut off
+        return;
+    }
+    uint8_t length = frame_overflow ? 0 : decodeFrame();
+    if (length == 0) {
+        frames_rejected++;
+    } else if (frame_handler != 0) {
+        frame_handler(frame, length);
+    }
+    frame_length = 0;
+    in_frame = 0;
+}
+
+static void runLine(void) {
+    line[line_length] = '\0';
+
+    // Split "name argument"
+    char* argument_text = strchr(line, ' ');
+    uint16_t argument = 0;
+    uint8_t has_argument = 0;
+    if (argument_text != NULL) {
+        *argument_text++ = '\0';
+        while (*argument_text >= '0' && *argument_text <= '9') {
+            uint8_t digit = *argument_text - '0';
+            if (argument > (UINT16_MAX - digit) / 10) break;  // Past 65535: a bad argument
+            argument = argument * 10 + digit;
+            argument_text++;
+            has_argument = 1;
+        }
+        if (*argument_text != '\0') {
+            printString_P(PSTR("error: bad argument\n"));
+            return;
+        }
+    }
+
+    for (uint8_t i = 0; i < command_count; i++) {
+        if (strcmp_P(line, command_table[i].name) == 0) {
+            CommandHandler handler = (CommandHandler)pgm_read_ptr(&command_table[i].handler);
+            handler(argument, has_argument);
+            return;
+        }
+    }
+    printString_P(PSTR("error: unknown command '"));
+    printString(line);
+    printString_P(PSTR("'\n"));
+}
+
+void pollConsole(void) {
+    for (uint8_t i = 0; i < CONSOLE_BYTES_PER_POLL; i++) {
+        int16_t data = usartRead();
+        if (data == USART_NO_DATA) return;
+
+        if (data == 0) {
+            uint8_t complete = frame_length > 0;
+            frameDelimiter();
+            if (complete) return;  // a frame counts as a command
+            continue;
+        }
+        if (in_frame) {
+            if (frame_length < CONSOLE_FRAME_LENGTH) {
+                frame[frame_length++] = data;
+            } else {
+                frame_overflow = 1;
+            }
+            continue;
+        }
+
+        if (data == '\r' || data == '\n') {
+            uint8_t complete = line_length > 0 && !line_overflow;
+            if (line_overflow) printString_P(PSTR("error: line too long\n"));
+            if (complete) runLine();
+            line_length = 0;
+            line_overflow = 0;
+            if (complete) return;  // at most one command per call
+            continue;
+        }
+
+        if (line_length < CONSOLE_LINE_LENGTH) {
+            line[line_length++] = data;
+        } else {
+            line_overflow = 1;
+        }
+    }
+}
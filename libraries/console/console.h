@@ -0,0 +1,43 @@
+/* Non-blocking serial command interpreter.
+
+   pollConsole() is called from the main loop. Each call consumes at most
+   CONSOLE_BYTES_PER_POLL bytes from the USART receive buffer and runs at most
+   one complete command, so its cost per call is bounded no matter how fast
+   the host types.
+
+   A command is one line: a name, optionally followed by a space and a
+   decimal argument (0-65535), ended by '\r' or '\n'. Example: "level 5".
+
+   Binary records can share the input: a 0x00 byte starts a frame, framed
+   like telemetry (0x00, COBS(record + crc), 0x00, see telemetry_protocol.h),
+   and the next 0x00 ends it. Frames that pass the CRC go to the handler set
+   with consoleOnFrame(); the others are counted and dropped.
+ */
+#ifndef CONSOLE_H
+#define CONSOLE_H
+
+#include <stdint.h>
+
+#define CONSOLE_LINE_LENGTH 16
+#define CONSOLE_BYTES_PER_POLL 8
+
+typedef void (*CommandHandler)(uint16_t argument, uint8_t has_argument);
+
+#define CONSOLE_NAME_LENGTH 8  // longest command name + 1
+
+typedef struct {
+    char name[CONSOLE_NAME_LENGTH];
+    CommandHandler handler;
+} ConsoleCommand;
+
+#define CONSOLE_FRAME_LENGTH 32  // longest COBS-encoded frame (record + crc) accepted
+
+typedef void (*FrameHandler)(const uint8_t* record, uint8_t length);
+
+/* The command table must be declared PROGMEM; it is read straight from flash */
+void initConsole(const ConsoleCommand* commands, uint8_t count);
+void consoleOnFrame(FrameHandler handler);
+void pollConsole(void);
+uint16_t consoleFramesRejected(void);  /* too long, or failed COBS or CRC */
+
+#endif
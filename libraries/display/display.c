@@ -1,24 +1,70 @@
 #include "display.h"
 
 #include <avr/io.h>
+#include <avr/pgmspace.h>
+#include <string.h>
+#include <util/atomic.h>
 #include <util/delay.h>
 
-/* Segment byte maps for numbers 0 to 9 */
-const uint8_t SEGMENT_MAP[] = {0xC0, 0xF9, 0xA4, 0xB0, 0x99,
-                               0x92, 0x82, 0xF8, 0X80, 0X90, 0xFF}; // <- index 10: all segments off (blank)
+/* Font for ASCII 0x20 to 0x7F, active low. Letters without a readable
+   7-segment form (K, M, W, X, ...) use the usual approximations. */
+static const uint8_t FONT[] PROGMEM = {
+    0xFF, 0x79, 0xDD, 0x81, 0x92, 0x2D, 0xB9, 0xDF,  //   ! " # $ % & '
+    0xC6, 0xF0, 0x9C, 0x8F, 0xEF, 0xBF, 0x7F, 0xAD,  // ( ) * + , - . /
+    0xC0, 0xF9, 0xA4, 0xB0, 0x99, 0x92, 0x82, 0xF8,  // 0 1 2 3 4 5 6 7
+    0x80, 0x90, 0xF6, 0xF2, 0xA7, 0xB7, 0xB3, 0x2C,  // 8 9 : ; < = > ?
+    0xA0, 0x88, 0x83, 0xC6, 0xA1, 0x86, 0x8E, 0xC2,  // @ A B C D E F G
+    0x89, 0xCF, 0xE1, 0x8A, 0xC7, 0xEA, 0xC8, 0xC0,  // H I J K L M N O
+    0x8C, 0x4A, 0xCC, 0x92, 0x87, 0xC1, 0xC1, 0xD5,  // P Q R S T U V W
+    0x89, 0x91, 0xA4, 0xC6, 0x9B, 0xF0, 0xDC, 0xF7,  // X Y Z [ \ ] ^ _
+    0xFD, 0xA0, 0x83, 0xA7, 0xA1, 0x84, 0x8E, 0x90,  // ` a b c d e f g
+    0x8B, 0xEF, 0xF1, 0x8A, 0xCF, 0xEA, 0xAB, 0xA3,  // h i j k l m n o
+    0x8C, 0x98, 0xAF, 0x92, 0x87, 0xE3, 0xE3, 0xD5,  // p q r s t u v w
+    0x89, 0x91, 0xA4, 0xC6, 0xCF, 0xF0, 0xFE, 0xFF,  // x y z { | } ~ DEL
+};
 
 /* Byte maps to select digit 1 to 4 */
 const uint8_t SEGMENT_SELECT[] = {0xF1, 0xF2, 0xF4, 0xF8};
 
-const uint8_t CHAR_MAP[] = {0x88, 0x83, 0xC6, 0xA1, 0x86, 0x8E, 0xC2,
-                                0x89, 0xCF, 0xE1, 0x8A, 0xC7, 0xEA, 0xC8,
-                                0xC0, 0x8C, 0x4A, 0xCC, 0x92, 0x87, 0xC1,
-                                0xC1, 0xD5, 0x89, 0x91, 0xA4};
+/* Front/back pages for the multiplexer, one active-low pattern per bit-plane
+   of every column. Only the scan reads front_page's page; only the producer
+   writes the other one. Cleared to all off by initDisplay(). */
+static uint8_t framebuffer[2][NUMBER_OF_DIGITS][DISPLAY_BCM_BITS];
+static volatile uint8_t front_page = 0;
+static volatile uint8_t flip_pending = 0;
+static uint8_t back_page = 1;     // producer side only
+static uint8_t scan_column = 0;   // scan side only
+#if DISPLAY_BCM_BITS > 1
+static const uint8_t* plane_patterns;  // planes of the column in its slot (scan side only)
+static uint8_t plane_column;
+static uint8_t plane = 0;
+static uint16_t plane_counts;          // how long the plane being shown lasts
+#endif
+static uint8_t patch_column = 0;
+static volatile uint8_t patch_pending = 0;
+static volatile uint16_t frames_presented = 0;
+static uint16_t frames_superseded = 0;  // only written with interrupts off
+
+/* Marquee: while marquee_active is set, displayMarqueeTick() is the producer
+   and draws frames from the timer interrupt; displayBeginFrame() clears it. */
+static char marquee_text[DISPLAY_MARQUEE_LENGTH];
+static uint8_t marquee_length = 0;
+static uint8_t marquee_offset = 0;  // index of the character in column 0
+static uint8_t marquee_wait = 0;    // ticks left before the next step
+static uint8_t marquee_level = DISPLAY_LEVEL_MAX;
+static volatile uint8_t marquee_active = 0;
 
 void initDisplay() {
   sbi(DDRD, LATCH_DIO);
   sbi(DDRD, CLK_DIO);
   sbi(DDRB, DATA_DIO);
+  for (uint8_t page = 0; page < 2; page++) {
+    for (uint8_t i = 0; i < NUMBER_OF_DIGITS; i++) {
+      for (uint8_t b = 0; b < DISPLAY_BCM_BITS; b++) {
+        framebuffer[page][i][b] = 0xFF;
+      }
+    }
+  }
 }
 
 // loop through seven segments of LED display and shift the correct bits in the
@@ -44,81 +90,309 @@ void shift(uint8_t val, uint8_t bitorder) {
   }
 }
 
-//Writes a digit to a certain segment. Segment 0 is the leftmost.
+// Fast path for the multiplexer: one bit, MSB-first, straight port bit writes.
+// The bit index is a constant, so every test compiles to a single sbrs/sbrc.
+#define SHIFT_BIT_FAST(val, bit)      \
+  do {                                \
+    if ((val) & (1 << (bit)))         \
+      sbi(PORTB, DATA_DIO);           \
+    else                              \
+      cbi(PORTB, DATA_DIO);           \
+    sbi(PORTD, CLK_DIO);              \
+    cbi(PORTD, CLK_DIO);              \
+  } while (0)
+
+// Unrolled MSB-first version of shift(): no bit order test, no runtime 1 << i
+static inline __attribute__((always_inline)) void shiftFast(uint8_t val) {
+  SHIFT_BIT_FAST(val, 7);
+  SHIFT_BIT_FAST(val, 6);
+  SHIFT_BIT_FAST(val, 5);
+  SHIFT_BIT_FAST(val, 4);
+  SHIFT_BIT_FAST(val, 3);
+  SHIFT_BIT_FAST(val, 2);
+  SHIFT_BIT_FAST(val, 1);
+  SHIFT_BIT_FAST(val, 0);
+}
+
+uint8_t displayGlyph(char character) {
+  uint8_t code = (uint8_t)character;
+  if (code < ' ' || code > 0x7F) return 0xFF;  // blank
+  return pgm_read_byte(&FONT[code - ' ']);
+}
+
+//Writes a digit to a certain segment. Segment 0 is the leftmost; 10 blanks it.
+//Shown until the scan reaches the segment again: only for use without the timer.
 void writeNumberToSegment(uint8_t segment, uint8_t value) {
   cbi(PORTD, LATCH_DIO);
-  shift(SEGMENT_MAP[value], MSBFIRST);
+  shift(value < 10 ? displayGlyph('0' + value) : 0xFF, MSBFIRST);
   shift(SEGMENT_SELECT[segment], MSBFIRST);
   sbi(PORTD, LATCH_DIO);
 }
 
-//Writes a nuber between 0 and 9999 to the display. To be used in a loop...
+//Shows a number between 0 and 9999 (right-aligned) until the next frame is drawn.
 void writeNumber(int number) {
   if (number < 0 || number > 9999) return;
-  writeNumberToSegment(0, number / 1000);
-  writeNumberToSegment(1, (number / 100) % 10);
-  writeNumberToSegment(2, (number / 10) % 10);
-  writeNumberToSegment(3, number % 10);
+  displayBeginFrame();
+  displayDrawNumber((uint16_t)number, DISPLAY_LEVEL_MAX);
+  displayEndFrame();
 }
 
-//Writes a number between 0 and 9999 to the display and makes sure that it stays there a certain number of millisecs.
-//Note: the timing is approximate; the amount of time writeNumberToSegment takes is not accounted for...
+//Shows a number between 0 and 9999 for a number of milliseconds. The timer
+//interrupt multiplexes it, so this only waits.
 void writeNumberAndWait(int number, int delay) {
   if (number < 0 || number > 9999) return;
-  for (int i = 0; i < delay / 20; i++) {
-    writeNumberToSegment(0, number / 1000);
-    _delay_ms(5);
-    writeNumberToSegment(1, (number / 100) % 10);
-    _delay_ms(5);
-    writeNumberToSegment(2, (number / 10) % 10);
-    _delay_ms(5);
-    writeNumberToSegment(3, number % 10);
-    _delay_ms(5);
+  writeNumber(number);
+  for (int i = 0; i < delay; i++) {
+    _delay_ms(1);
   }
 }
 
+// Called from the timer interrupt for every multiplexed column, so it uses the
+// unrolled shift: pattern byte first, then the digit select byte.
 void writeRawToSegment(uint8_t segment, uint8_t pattern) {
+  uint8_t select = SEGMENT_SELECT[segment & 0x03];
   cbi(PORTD, LATCH_DIO);
-  shift(pattern, MSBFIRST);
-  shift(SEGMENT_SELECT[segment], MSBFIRST);
+  shiftFast(pattern);
+  shiftFast(select);
   sbi(PORTD, LATCH_DIO);
 }
 
+//Like writeNumberToSegment(), for any character of the font
 void writeCharToSegment(uint8_t segment, char character) {
-    uint8_t pattern;
-
-    if (character >= 'a' && character <= 'z') {
-        character -= 32; // convert to uppercase
-    } else if (character >= 'A' && character <= 'Z') {
-        pattern = CHAR_MAP[character - 'A'];
-    } else if (character == ' ') {
-      return 0xFF; // All segments off
-      } else {
-        return 0xFF;
+  writeRawToSegment(segment, displayGlyph(character));
+}
+
+//Shows a string until the next frame is drawn; longer ones scroll
+void writeString(const char* str) {
+  displayMarquee(str, DISPLAY_LEVEL_MAX);
+}
+
+void writeStringAndWait(const char* str, int delay) {
+  writeString(str);
+  for (int i = 0; i < delay; i++) {
+    _delay_ms(1);
+  }
+}
+
+// Frame setup shared by the producers (the caller or the marquee tick)
+static void beginFrame(void) {
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    if (flip_pending) {
+      // The last published frame never reached column 0: take its page back
+      flip_pending = 0;
+      frames_superseded++;
+    }
+    back_page = front_page ^ 1;
+  }
+  for (uint8_t i = 0; i < NUMBER_OF_DIGITS; i++) {
+    for (uint8_t b = 0; b < DISPLAY_BCM_BITS; b++) {
+      framebuffer[back_page][i][b] = 0xFF;
+    }
+  }
+}
+
+void displayDrawRaw(uint8_t column, uint8_t pattern) {
+  displayDrawSegmentsLevel(column, ~pattern, DISPLAY_LEVEL_MAX);
+}
+
+void displayDrawSegments(uint8_t column, uint8_t segments) {
+  displayDrawSegmentsLevel(column, segments, DISPLAY_LEVEL_MAX);
+}
+
+void displayDrawSegmentsLevel(uint8_t column, uint8_t segments, uint8_t level) {
+  if (column >= NUMBER_OF_DIGITS) return;
+  if (level > DISPLAY_LEVEL_MAX) level = DISPLAY_LEVEL_MAX;
+  // Keep the top DISPLAY_BCM_BITS bits, but never round a lit segment off
+  uint8_t code = level >> (4 - DISPLAY_BCM_BITS);
+  if (code == 0 && level != 0) code = 1;
+  uint8_t* planes = framebuffer[back_page][column];
+  for (uint8_t b = 0; b < DISPLAY_BCM_BITS; b++) {
+    if (code & (1 << b)) planes[b] &= ~segments;
+  }
+}
+
+void displayBeginFrame(void) {
+  marquee_active = 0;  // the caller draws from now on
+  beginFrame();
+}
+
+void displayEndFrame(void) {
+  flip_pending = 1;  // single byte store: the page swap itself happens in the scan
+}
+
+void displayPatchColumn(uint8_t column, uint8_t segments) {
+  if (column >= NUMBER_OF_DIGITS) return;
+  // Both pages: the shown one, and the other in case it is published and
+  // waiting for column 0 (otherwise the next displayBeginFrame() clears it)
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    for (uint8_t page = 0; page < 2; page++) {
+      uint8_t* planes = framebuffer[page][column];
+      uint8_t lit = 0;
+      for (uint8_t b = 0; b < DISPLAY_BCM_BITS; b++) {
+        lit |= ~planes[b];
       }
+      uint8_t added = segments & ~lit;  // these come on at full brightness
+      for (uint8_t b = 0; b < DISPLAY_BCM_BITS; b++) {
+        planes[b] = (planes[b] | ~segments) & ~added;
+      }
+    }
+    patch_column = column;
+    patch_pending = 1;
+  }
+}
+
+uint8_t displayPatchPending(void) {
+  return patch_pending;
+}
+
+void displayScanNext(void) {
+  if (scan_column == 0 && flip_pending) {
+    front_page ^= 1;
+    flip_pending = 0;
+    frames_presented++;
+  }
+#if DISPLAY_BCM_BITS > 1
+  // Plane 0 is timed from before its write, like the later planes are timed
+  // from the compare match that starts their interrupt. The last plane runs
+  // until the next column, so it takes up any jitter of this call.
+  uint16_t start = TCNT1;
+  plane_patterns = framebuffer[front_page][scan_column];
+  plane_column = scan_column;
+  plane = 0;
+  plane_counts = DISPLAY_PLANE_COUNTS;
+  writeRawToSegment(scan_column, plane_patterns[0]);
+  OCR1B = start + DISPLAY_PLANE_COUNTS;
+  TIFR1 = _BV(OCF1B);  // drop a stale match
+  TIMSK1 |= _BV(OCIE1B);
+#else
+  writeRawToSegment(scan_column, framebuffer[front_page][scan_column][0]);
+#endif
+  if (scan_column == patch_column) patch_pending = 0;
+  scan_column = (scan_column + 1) & (NUMBER_OF_DIGITS - 1);
+}
+
+// Same work for every plane: one column write and one compare update
+void displayPlaneNext(void) {
+#if DISPLAY_BCM_BITS > 1
+  plane++;
+  writeRawToSegment(plane_column, plane_patterns[plane]);
+  if (plane == DISPLAY_BCM_BITS - 1) {
+    TIMSK1 &= ~_BV(OCIE1B);  // the last plane lasts until the next column
+  } else {
+    plane_counts <<= 1;
+    OCR1B += plane_counts;
+  }
+#endif
+}
 
-    writeRawToSegment(segment, pattern);
+uint16_t displayFramesPresented(void) {
+  uint16_t count;
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    count = frames_presented;
+  }
+  return count;
+}
+
+uint16_t displayFramesSuperseded(void) {
+  uint16_t count;
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    count = frames_superseded;
+  }
+  return count;
 }
 
-void writeString(char* str) {
-    for (int i = 0; i < 4; i++) {
-        if (str[i] == ' ') {
-            writeCharToSegment(i, ' ');
-        } else {
-            writeCharToSegment(i, str[i]);
-        }
+void displayDrawText(uint8_t column, const char* text, uint8_t level) {
+  for (; *text && column < NUMBER_OF_DIGITS; text++, column++) {
+    displayDrawSegmentsLevel(column, ~displayGlyph(*text), level);
+  }
+}
+
+void displayDrawText_P(uint8_t column, const char* text, uint8_t level) {
+  char character;
+  for (; (character = pgm_read_byte(text)) && column < NUMBER_OF_DIGITS; text++, column++) {
+    displayDrawSegmentsLevel(column, ~displayGlyph(character), level);
+  }
+}
+
+void displayDrawNumber(uint16_t number, uint8_t level) {
+  if (number > 9999) {
+    displayDrawText_P(0, PSTR("----"), level);
+    return;
+  }
+  uint8_t column = NUMBER_OF_DIGITS;
+  do {
+    displayDrawSegmentsLevel(--column, ~displayGlyph('0' + number % 10), level);
+    number /= 10;
+  } while (number);
+}
+
+// Draws the four characters from marquee_offset on; the text is followed by
+// a gap of NUMBER_OF_DIGITS blanks before it comes round again
+static void drawMarquee(void) {
+  uint8_t cycle = marquee_length + NUMBER_OF_DIGITS;
+  beginFrame();
+  for (uint8_t column = 0; column < NUMBER_OF_DIGITS; column++) {
+    uint8_t at = marquee_offset + column;
+    if (at >= cycle) at -= cycle;
+    if (at < marquee_length) {
+      displayDrawSegmentsLevel(column, ~displayGlyph(marquee_text[at]), marquee_level);
     }
+  }
+  displayEndFrame();
+}
+
+// The text is in marquee_text and the tick is stopped
+static void startMarquee(uint8_t level) {
+  marquee_length = strlen(marquee_text);
+  marquee_offset = 0;
+  marquee_wait = DISPLAY_MARQUEE_HOLD;
+  marquee_level = level;
+  drawMarquee();
+  if (marquee_length > NUMBER_OF_DIGITS) marquee_active = 1;
 }
 
-void writeStringAndWait(char* str, int delay) {
-  for (int i = 0; i < delay / 20; i++) {
-    writeCharToSegment(0, str[0] ? str[0] : ' ');
-    _delay_ms(5);
-    writeCharToSegment(1, str[1] ? str[1] : ' ');
-    _delay_ms(5);
-    writeCharToSegment(2, str[2] ? str[2] : ' ');
-    _delay_ms(5);
-    writeCharToSegment(3, str[3] ? str[3] : ' ');
-    _delay_ms(5);
+void displayMarquee(const char* text, uint8_t level) {
+  marquee_active = 0;
+  strncpy(marquee_text, text, DISPLAY_MARQUEE_LENGTH - 1);
+  marquee_text[DISPLAY_MARQUEE_LENGTH - 1] = '\0';
+  startMarquee(level);
+}
+
+void displayMarquee_P(const char* text, uint8_t level) {
+  marquee_active = 0;
+  strncpy_P(marquee_text, text, DISPLAY_MARQUEE_LENGTH - 1);
+  marquee_text[DISPLAY_MARQUEE_LENGTH - 1] = '\0';
+  startMarquee(level);
+}
+
+void displayMarqueeNumber_P(const char* label, uint16_t number, uint8_t level) {
+  marquee_active = 0;
+  char digits[5];
+  uint8_t count = 0;
+  do {
+    digits[count++] = '0' + number % 10;
+    number /= 10;
+  } while (number);
+  strncpy_P(marquee_text, label, DISPLAY_MARQUEE_LENGTH - 1);
+  marquee_text[DISPLAY_MARQUEE_LENGTH - 1] = '\0';
+  uint8_t length = strlen(marquee_text);
+  while (count && length < DISPLAY_MARQUEE_LENGTH - 1) {
+    marquee_text[length++] = digits[--count];
+  }
+  marquee_text[length] = '\0';
+  startMarquee(level);
+}
+
+void displayMarqueeTick(void) {
+  if (!marquee_active) return;
+  if (marquee_wait) {
+    marquee_wait--;
+    return;
   }
-}
\ No newline at end of file
+  marquee_offset++;
+  if (marquee_offset == marquee_length + NUMBER_OF_DIGITS) {
+    marquee_offset = 0;
+    marquee_wait = DISPLAY_MARQUEE_HOLD;  // hold the start again before the next pass
+  }
+  drawMarquee();
+}
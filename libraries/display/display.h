@@ -10,17 +10,79 @@
 #define LSBFIRST 0
 #define MSBFIRST 1
 #define NUMBER_OF_SEGMENTS 8
+#define NUMBER_OF_DIGITS 4
 
 #define sbi(register, bit) (register |= _BV(bit))
 #define cbi(register, bit) (register &= ~_BV(bit))
 
-extern const uint8_t SEGMENT_MAP[11];  // telling the compiler it's defined elsewhere so i can finally use it in main() omg
-
 void initDisplay();
+uint8_t displayGlyph(char character);  // font pattern (active low) of an ASCII character, blank if none
 void writeNumberToSegment(uint8_t segment, uint8_t value);
-void writeNumber(int number);
+void writeNumber(int number);                      // draws a frame, see displayDrawNumber()
 void writeNumberAndWait(int number, int delay);
 void writeRawToSegment(uint8_t segment, uint8_t pattern);
 void writeCharToSegment(uint8_t segment, char character);
-void writeString(char* str);
-void writeStringAndWait(char* str, int delay);
+void writeString(const char* str);                 // same as displayMarquee() at full brightness
+void writeStringAndWait(const char* str, int delay);
+
+/* Brightness: binary code modulation inside each column's multiplex slot.
+   Every column is stored as DISPLAY_BCM_BITS bit-planes; plane b is shown for
+   2^b units of the slot, so a segment's on time is proportional to its level.
+   displayScanNext() outputs plane 0 and arms Timer1 compare B, whose interrupt
+   calls displayPlaneNext() for the remaining planes. Each of those interrupts
+   costs one writeRawToSegment() and a compare update, whatever is on screen.
+   The display owns OCR1B and OCIE1B. Build with -D DISPLAY_BCM_BITS=1 to turn
+   modulation off (one write per slot, as before). */
+#ifndef DISPLAY_BCM_BITS
+#define DISPLAY_BCM_BITS 3
+#endif
+#if DISPLAY_BCM_BITS < 1 || DISPLAY_BCM_BITS > 4
+#error "DISPLAY_BCM_BITS must be 1 to 4"
+#endif
+#define DISPLAY_SLOT_COUNTS 4000  // Timer1 counts per column slot (2ms at 2MHz)
+#define DISPLAY_PLANE_COUNTS (DISPLAY_SLOT_COUNTS / ((1 << DISPLAY_BCM_BITS) - 1))  // plane 0
+#define DISPLAY_LEVEL_MAX 15      // levels are 0-15 at any depth; the top bits are shown
+
+/* Double-buffered framebuffer for the multiplexed display.
+   Producers draw a whole frame into the back page between displayBeginFrame()
+   and displayEndFrame(); the scan (displayScanNext, called from the timer
+   interrupt) flips to the published page only when it is back at column 0,
+   so a frame is never shown half old, half new.
+   Patterns are active low, like displayGlyph(): a 0 bit lights the segment.
+   displayDrawRaw() and displayDrawSegments() draw at full brightness; drawing a
+   segment twice ORs its levels together. */
+void displayBeginFrame(void);                              // claim the back page, all segments off
+void displayDrawRaw(uint8_t column, uint8_t pattern);      // AND an active-low pattern into the back page
+void displayDrawSegments(uint8_t column, uint8_t segments);  // light the segments set in the mask
+void displayDrawSegmentsLevel(uint8_t column, uint8_t segments, uint8_t level);  // ... at a brightness
+void displayEndFrame(void);                                // publish the back page
+void displayDrawText(uint8_t column, const char* text, uint8_t level);    // from column on, clipped
+void displayDrawText_P(uint8_t column, const char* text, uint8_t level);  // ... from flash
+void displayDrawNumber(uint16_t number, uint8_t level);  // right-aligned; over 9999 shows ----
+void displayScanNext(void);                                // show the next column (ISR)
+void displayPlaneNext(void);                               // show the next bit-plane (TIMER1_COMPB ISR)
+
+/* Fast path for a change that should not wait for the next frame: replaces one
+   column of the frame being shown (and of a published frame not yet shown) with
+   the segments in the mask. Segments that were lit keep their brightness, newly
+   lit ones are at full brightness. The scan outputs it within NUMBER_OF_DIGITS
+   scan steps. Call it outside displayBeginFrame()/displayEndFrame(). */
+void displayPatchColumn(uint8_t column, uint8_t segments);
+uint8_t displayPatchPending(void);      // 1 until the scan has output the patched column
+
+uint16_t displayFramesPresented(void);  // frames the scan has flipped to
+uint16_t displayFramesSuperseded(void); // frames replaced before they were ever shown
+
+/* Marquee: shows a text of up to DISPLAY_MARQUEE_LENGTH - 1 characters (it is
+   copied). One that does not fit scrolls left one character per call to
+   displayMarqueeTick(), a scheduler task every DISPLAY_MARQUEE_PERIOD ms, with
+   the start held for DISPLAY_MARQUEE_HOLD steps. The tick draws whole frames
+   from the interrupt, so it needs no help from the caller; the next
+   displayBeginFrame() stops it. */
+#define DISPLAY_MARQUEE_LENGTH 32
+#define DISPLAY_MARQUEE_PERIOD 300
+#define DISPLAY_MARQUEE_HOLD 3
+void displayMarquee(const char* text, uint8_t level);
+void displayMarquee_P(const char* text, uint8_t level);
+void displayMarqueeNumber_P(const char* label, uint16_t number, uint8_t level);  // label, then the number
+void displayMarqueeTick(void);
@@ -0,0 +1,30 @@
+#include <stdint.h>
+#include "entities.h"
+
+void clearEntities(EntityPool* pool) {
+    pool->live = 0;  // the attribute arrays are rewritten on spawn
+}
+
+uint8_t spawnEntity(EntityPool* pool, uint8_t type, uint8_t column, uint8_t position,
+                    uint8_t velocity_x, int8_t velocity_y) {
+    EntityMask free_slots = ~pool->live;
+    if (free_slots == 0) return ENTITY_NONE;
+
+    uint8_t entity = __builtin_ctz(free_slots);
+    pool->type[entity] = type;
+    pool->column[entity] = column << ENTITY_SUBSTEP_BITS;
+    pool->position[entity] = position;
+    pool->velocity_x[entity] = velocity_x;
+    pool->velocity_y[entity] = velocity_y;
+    pool->live |= ENTITY_BIT(entity);
+    return entity;
+}
+
+void despawnEntity(EntityPool* pool, uint8_t entity) {
+    if (entity >= ENTITY_CAPACITY) return;
+    pool->live &= ~ENTITY_BIT(entity);
+}
+
+uint8_t entityCount(const EntityPool* pool) {
+    return __builtin_popcount(pool->live);
+}
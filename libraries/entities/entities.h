@@ -0,0 +1,54 @@
+/* Fixed-capacity entity store, structure-of-arrays.
+
+   Every attribute lives in its own array indexed by entity slot, and a bit
+   mask says which slots are alive. Spawning takes the lowest free bit and
+   despawning clears one, so neither depends on how many entities exist,
+   and nothing is ever allocated from the heap.
+
+   Columns are fixed point: ENTITY_SUBSTEPS steps per display column, so an
+   entity's horizontal speed can be a fraction of a column per tick.
+ */
+#ifndef ENTITIES_H
+#define ENTITIES_H
+
+#include <stdint.h>
+
+#define ENTITY_CAPACITY 16          /* one bit per slot in EntityMask */
+#define ENTITY_NONE 0xFF            /* spawnEntity() result when the pool is full */
+#define ENTITY_SUBSTEP_BITS 2
+#define ENTITY_SUBSTEPS (1 << ENTITY_SUBSTEP_BITS)
+
+typedef uint16_t EntityMask;
+
+typedef struct {
+    uint8_t type[ENTITY_CAPACITY];        /* meaning is up to the game */
+    uint8_t column[ENTITY_CAPACITY];      /* fixed point, see ENTITY_SUBSTEPS */
+    uint8_t position[ENTITY_CAPACITY];    /* vertical position (segment index) */
+    uint8_t velocity_x[ENTITY_CAPACITY];  /* substeps moved left per tick */
+    int8_t velocity_y[ENTITY_CAPACITY];   /* positions moved per tick */
+    EntityMask live;
+} EntityPool;
+
+#define ENTITY_COLUMN(pool, entity) ((pool)->column[entity] >> ENTITY_SUBSTEP_BITS)
+#define ENTITY_BIT(entity) ((EntityMask)1 << (entity))
+
+void clearEntities(EntityPool* pool);
+
+/* Takes the lowest free slot. column is in whole display columns.
+   Returns the slot, or ENTITY_NONE when the pool is full. */
+uint8_t spawnEntity(EntityPool* pool, uint8_t type, uint8_t column, uint8_t position,
+                    uint8_t velocity_x, int8_t velocity_y);
+void despawnEntity(EntityPool* pool, uint8_t entity);
+uint8_t entityCount(const EntityPool* pool);
+
+/* Iterate live slots:
+     EntityMask remaining = pool->live;
+     while (remaining) { uint8_t i = nextEntity(&remaining); ... }
+   Despawning the current slot inside the loop is allowed. */
+static inline uint8_t nextEntity(EntityMask* remaining) {
+    uint8_t entity = __builtin_ctz(*remaining);
+    *remaining &= *remaining - 1;  // clear the lowest set bit
+    return entity;
+}
+
+#endif
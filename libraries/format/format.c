@@ -0,0 +1,103 @@
+#include <stdint.h>
+#include <avr/pgmspace.h>
+#include <usart.h>
+#include "format.h"
+
+#define MAX_DIGITS 10  // 4294967295
+
+// Writes the decimal digits of value into digits[], least significant
+// first, and returns how many there are (at least one).
+static uint8_t decimalDigits(uint32_t value, char* digits) {
+    uint8_t count = 0;
+
+    // 32-bit division (~600 cycles per digit) only while it is needed
+    while (value > 0xFFFF) {
+        digits[count++] = '0' + value % 10;
+        value /= 10;
+    }
+
+    uint16_t small = value;
+    do {
+        digits[count++] = '0' + small % 10;
+        small /= 10;
+    } while (small != 0);
+    return count;
+}
+
+static void printSpaces(uint8_t count) {
+    while (count--) {
+        transmitByte(' ');
+    }
+}
+
+void printU8(uint8_t value) {
+    if (value >= 10) {
+        if (value >= 100) {
+            transmitByte('0' + value / 100);
+            value %= 100;
+        }
+        transmitByte('0' + value / 10);
+        value %= 10;
+    }
+    transmitByte('0' + value);
+}
+
+void printU16(uint16_t value) {
+    printU32Right(value, 0);
+}
+
+void printU32(uint32_t value) {
+    printU32Right(value, 0);
+}
+
+void printU32Right(uint32_t value, uint8_t width) {
+    char digits[MAX_DIGITS];
+    uint8_t count = decimalDigits(value, digits);
+
+    if (width > count) printSpaces(width - count);
+    while (count > 0) {
+        transmitByte(digits[--count]);
+    }
+}
+
+void printFixed(int32_t value, uint8_t decimals) {
+    char digits[MAX_DIGITS];
+    uint32_t magnitude = value;
+
+    if (decimals > MAX_DIGITS - 1) decimals = MAX_DIGITS - 1;
+    if (value < 0) {
+        transmitByte('-');
+        magnitude = -magnitude;
+    }
+
+    // At least one digit before the point: 5 with 2 decimals is "0.05"
+    uint8_t count = decimalDigits(magnitude, digits);
+    while (count <= decimals) {
+        digits[count++] = '0';
+    }
+
+    while (count > 0) {
+        if (count == decimals) transmitByte('.');
+        transmitByte(digits[--count]);
+    }
+}
+
+void printHex8(uint8_t value) {
+    transmitByte(nibbleToHexCharacter(value >> 4));
+    transmitByte(nibbleToHexCharacter(value & 0x0F));
+}
+
+void printHex16(uint16_t value) {
+    printHex8(value >> 8);
+    printHex8(value & 0xFF);
+}
+
+void printPadded_P(PGM_P text, uint8_t width) {
+    uint8_t length = 0;
+    char character;
+    while ((character = pgm_read_byte(text++))) {
+        transmitByte(character);
+        length++;
+    }
+    if (width > length) printSpaces(width - length);
+}
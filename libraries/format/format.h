@@ -0,0 +1,40 @@
+/* Typed number and string emitters for serial output.
+
+   Each function writes straight into the USART transmit path with
+   transmitByte(), keeping at most a 10-byte digit buffer on the stack.
+   They replace printf() for status output: no format string is parsed at
+   run time, 32-bit arithmetic is only used for values above 65535, and
+   vfprintf() is not linked into the firmware at all.
+
+   Messages are built from several calls, for example:
+     printString_P(PSTR("Level: "));
+     printU8(level);
+     transmitByte('\n');
+ */
+#ifndef FORMAT_H
+#define FORMAT_H
+
+#include <stdint.h>
+#include <avr/pgmspace.h>
+
+void printU8(uint8_t value);
+void printU16(uint16_t value);
+void printU32(uint32_t value);
+/* Unsigned decimal, no padding */
+
+void printU32Right(uint32_t value, uint8_t width);
+/* Unsigned decimal, right-aligned with spaces to at least width characters */
+
+void printFixed(int32_t value, uint8_t decimals);
+/* Fixed-point decimal: value is in units of 10^-decimals (0-9 decimals),
+   so printFixed(1234, 3) prints "1.234" and printFixed(-5, 2) "-0.05" */
+
+void printHex8(uint8_t value);
+void printHex16(uint16_t value);
+/* Upper-case hexadecimal, always 2 or 4 digits, no prefix */
+
+void printPadded_P(PGM_P text, uint8_t width);
+/* Flash string, left-aligned with spaces to at least width characters.
+   Plain flash strings go through printString_P() in the usart library. */
+
+#endif
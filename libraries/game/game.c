@@ -0,0 +1,405 @@
+#include <stdint.h>
+#include <avr/pgmspace.h>
+#include "game.h"
+#include "game_hal.h"
+#include "entities.h"
+#include "rng.h"
+#include "beatmap.h"
+#include "beatstream.h"
+#include "replay.h"
+#include "telemetry_protocol.h"
+#include "profiler.h"
+
+static void spawnBlocks(GameState* game);
+static void spawnFromBeatmap(GameState* game);
+static void spawnFromStream(GameState* game);
+static void spawnBeatmapEvent(GameState* game, uint8_t event);
+static void endBeatmap(GameState* game);
+static void spawnRandomBlocks(GameState* game);
+static void moveBlocks(GameState* game);
+static void checkCollisions(GameState* game);
+static void loseLife(GameState* game);
+static void collectPowerup(GameState* game);
+static uint8_t addBlock(GameState* game, uint8_t type, uint8_t position, uint8_t velocity_x, int8_t velocity_y);
+static uint8_t entityShape(uint8_t type, uint8_t position);
+static void rasterizeEntity(GameState* game, uint8_t entity);
+static void rasterizeEntities(GameState* game);
+
+void gameInit(GameState* game) {
+    game->level = INITIAL_LEVEL;
+    game->lives = MAX_LIVES;
+    game->spaceship_position = SPACESHIP_START_POSITION;
+    game->score = 0;
+    game->game_running = 1;
+    game->blocks_dodged = 0;
+    game->ticks = 0;
+    game->spawns_dropped = 0;
+    game->block_source = BLOCKS_RANDOM;
+    gameSeed(game, 0);
+    gameClear(game);
+}
+
+void gameSeed(GameState* game, uint16_t seed) {
+    game->seed = seed;
+    rngSeed(&game->rng, seed);
+}
+
+uint8_t gameUseBeatmap(GameState* game, PGM_P map) {
+    if (!beatmapOpen(&game->beatmap, map)) return 0;
+    game->block_source = BLOCKS_BEATMAP;
+    return 1;
+}
+
+void gameUseStream(GameState* game) {
+    game->block_source = BLOCKS_STREAM;
+}
+
+void gameTick(GameState* game) {
+    game->ticks++;
+
+    PROFILE_BEGIN(PROF_MOVE_BLOCKS);
+    moveBlocks(game);
+    PROFILE_END(PROF_MOVE_BLOCKS);
+
+    PROFILE_BEGIN(PROF_SPAWN_BLOCKS);
+    spawnBlocks(game);
+    PROFILE_END(PROF_SPAWN_BLOCKS);
+
+    PROFILE_BEGIN(PROF_CHECK_COLLISIONS);
+    checkCollisions(game);
+    PROFILE_END(PROF_CHECK_COLLISIONS);
+
+    // Level progression based on blocks dodged
+    uint8_t new_level = (game->blocks_dodged / 10) + game->level;
+    if (new_level > game->level && new_level <= MAX_LEVEL) {
+        game->level = new_level;
+        uint16_t game_speed = gameTickPeriod(game);
+        if (game->block_source == BLOCKS_RANDOM) halSetTickPeriod(game_speed);
+        halReportLevelUp(game->level, game_speed);
+        halPlaySound(GAME_SOUND_LEVEL_UP);
+    }
+}
+
+// A move between ticks: catches a block the ship steps into right away
+void gameMoveShip(GameState* game, uint8_t position) {
+    if (!game->game_running) return;  // The last life is gone: nothing more to hit
+    game->spaceship_position = position;
+    checkCollisions(game);
+}
+
+void gameFinish(GameState* game) {
+    game->score = calculateScore(game->level, game->blocks_dodged);
+}
+
+void gameClear(GameState* game) {
+    clearEntities(&game->entities);
+    game->obstacles.all = 0;
+    game->powerups.all = 0;
+}
+
+uint8_t gameReplay(GameState* game, const uint8_t* recording, uint16_t size, PGM_P map) {
+    ReplayReader reader;
+    ReplayHeader header;
+    if (!replayOpen(&reader, &header, recording, size)) return GAME_REPLAY_INVALID;
+    if (header.source == BLOCKS_STREAM) return GAME_REPLAY_STREAMED;
+
+    gameInit(game);
+    gameSeed(game, header.seed);
+    if (header.source == BLOCKS_BEATMAP && !gameUseBeatmap(game, map)) return GAME_REPLAY_NO_MAP;
+    game->level = header.level;
+
+    // A tick's events come after it, as the board's main loop handles input after
+    // the tick; none come after the tick that ends the game
+    ReplayEvent event;
+    uint8_t pending = replayNext(&reader, &event);
+    while (1) {
+        while (pending && event.tick == game->ticks) {
+            if (event.kind == REPLAY_UP) {
+                gameMoveShip(game, game->spaceship_position - 1);
+            } else if (event.kind == REPLAY_DOWN) {
+                gameMoveShip(game, game->spaceship_position + 1);
+            } else if (event.kind == REPLAY_MOVE) {
+                gameMoveShip(game, event.value);
+            } else if (event.what == REPLAY_SET_LEVEL) {
+                game->level = event.value;
+            } else if (event.what == REPLAY_SET_SEED) {
+                gameSeed(game, event.value);
+            }
+            pending = replayNext(&reader, &event);
+        }
+        if (!game->game_running || game->ticks == header.ticks) break;
+        gameTick(game);
+    }
+
+    if (header.flags & REPLAY_TRUNCATED) return GAME_REPLAY_TRUNCATED;
+    gameFinish(game);
+    if (game->game_running || game->ticks != header.ticks || game->score != header.score) {
+        return GAME_REPLAY_MISMATCH;
+    }
+    return GAME_REPLAY_MATCH;
+}
+
+// Game tick period in milliseconds - only recomputed when the level changes
+uint16_t gameSpeedForLevel(uint8_t level) {
+    uint16_t reduction = level * 60;  // Reduced from 150 for more gradual speed increase
+    if (reduction > BASE_GAME_SPEED - MIN_GAME_SPEED) {
+        return MIN_GAME_SPEED;  // Reduced minimum speed from 300 to 150ms for faster gameplay
+    }
+    return BASE_GAME_SPEED - reduction;
+}
+
+// Game tick period in milliseconds: the beatmap's tempo while it plays, else the level's speed
+uint16_t gameTickPeriod(const GameState* game) {
+    if (game->block_source == BLOCKS_BEATMAP) return game->beatmap.tick_ms;
+    if (game->block_source == BLOCKS_STREAM) return beatstreamTickMs();
+    return gameSpeedForLevel(game->level);
+}
+
+uint16_t calculateScore(uint8_t level, unsigned long blocks_dodged) {
+    // Score calculation: base points for blocks dodged, bonus for level
+    return (blocks_dodged * 10) + (level * level * 50);
+}
+
+static void spawnBlocks(GameState* game) {
+    if (game->block_source == BLOCKS_BEATMAP) {
+        spawnFromBeatmap(game);
+    } else if (game->block_source == BLOCKS_STREAM) {
+        spawnFromStream(game);
+    } else {
+        spawnRandomBlocks(game);
+    }
+
+    #ifdef ENTITY_STRESS_TEST
+    // Keep the pool full so every tick runs at capacity
+    Rng* rng = &game->rng;
+    while (1) {
+        uint8_t type = rngBelow(rng, 3);
+        uint8_t position = rngBelow(rng, SPACESHIP_POSITION_COUNT - WALL_HEIGHT + 1);
+        uint8_t speed = (rngByte(rng) & 0x80) ? SPEED_SLOW : SPEED_NORMAL;
+        int8_t drift = rngBelow(rng, 3) - 1;
+        if (type == ENTITY_WALL) drift = 0;  // Walls never drift, as in spawnRandomBlocks()
+        if (addBlock(game, type, position, speed, drift) == ENTITY_NONE) break;
+    }
+    #endif
+}
+
+// Spawns this tick's beatmap events; each is a few bytes read from flash
+static void spawnFromBeatmap(GameState* game) {
+    uint8_t event;
+    while (beatmapNextEvent(&game->beatmap, &event)) {
+        spawnBeatmapEvent(game, event);
+    }
+    beatmapTick(&game->beatmap);
+
+    if (beatmapEnded(&game->beatmap)) endBeatmap(game);
+}
+
+// Spawns this tick's streamed events; the tick goes on whether the host kept up or not
+static void spawnFromStream(GameState* game) {
+    uint8_t event;
+    while (beatstreamNextEvent(&event)) {
+        spawnBeatmapEvent(game, event);
+    }
+    beatstreamTick();
+    halReportStream();  // Hands the host the credit of any bank just emptied
+
+    if (beatstreamFinished()) endBeatmap(game);
+}
+
+// Streamed events never went through beatmap_pack: a wall is kept whole and still here too
+static void spawnBeatmapEvent(GameState* game, uint8_t event) {
+    uint8_t kind = BEATMAP_KIND(event);
+    uint8_t position = BEATMAP_POSITION(event);
+    uint8_t drift = BEATMAP_DRIFT(event);
+    if (kind == ENTITY_WALL) {
+        if (position > BEATMAP_WALL_MAX_POSITION) position = BEATMAP_WALL_MAX_POSITION;
+        drift = BEATMAP_DRIFT_NONE;
+    }
+    addBlock(game, kind, position, BEATMAP_SLOW(event) ? SPEED_SLOW : SPEED_NORMAL,
+             drift == BEATMAP_DRIFT_DOWN ? 1 : (drift == BEATMAP_DRIFT_UP ? -1 : 0));
+}
+
+// The song is over: random blocks at the level's speed from the next tick on
+static void endBeatmap(GameState* game) {
+    game->block_source = BLOCKS_RANDOM;
+    halSetTickPeriod(gameTickPeriod(game));
+    halPrint_P(PSTR("Beatmap finished, random blocks from now on\n"));
+}
+
+static void spawnRandomBlocks(GameState* game) {
+    // Spawn probability increases with level
+    uint8_t spawn_chance = BLOCK_SPAWN_PROBABILITY + (game->level * 5);
+    if (spawn_chance > 80) spawn_chance = 80;  // Cap at 80%
+    uint8_t spawn_threshold = RNG_PERCENT(spawn_chance);
+    Rng* rng = &game->rng;
+
+    // Potentially spawn multiple blocks
+    uint8_t max_spawns = (game->level / 3) + 1;
+
+    for (uint8_t i = 0; i < max_spawns; i++) {
+        if (rngChance(rng, spawn_threshold)) {
+            // Pick the kind of obstacle
+            uint8_t type = ENTITY_BLOCK;
+            uint8_t kind_roll = rngByte(rng);
+            if (game->lives < MAX_LIVES && kind_roll < RNG_PERCENT(POWERUP_CHANCE)) {
+                type = ENTITY_POWERUP;
+            } else if (game->level >= WALL_MIN_LEVEL
+                       && kind_roll < RNG_PERCENT(POWERUP_CHANCE + WALL_CHANCE)) {
+                type = ENTITY_WALL;
+            }
+
+            uint8_t position_count = SPACESHIP_POSITION_COUNT;
+            if (type == ENTITY_WALL) position_count -= WALL_HEIGHT - 1;  // Keep the whole wall on screen
+            uint8_t position = rngBelow(rng, position_count);
+
+            uint8_t speed = rngChance(rng, RNG_PERCENT(SLOW_CHANCE)) ? SPEED_SLOW : SPEED_NORMAL;
+            int8_t drift = 0;
+            if (game->level >= DRIFT_MIN_LEVEL && type != ENTITY_WALL && rngChance(rng, RNG_PERCENT(25))) {
+                drift = (rngByte(rng) & 0x80) ? 1 : -1;
+            }
+
+            addBlock(game, type, position, speed, drift);
+        }
+    }
+}
+
+static void moveBlocks(GameState* game) {
+    EntityPool* entities = &game->entities;
+    uint8_t dodged = 0;
+    EntityMask remaining = entities->live;
+
+    while (remaining) {
+        uint8_t i = nextEntity(&remaining);
+
+        // Moving left past column 0 takes the entity off screen
+        if (entities->column[i] < entities->velocity_x[i]) {
+            if (entities->type[i] != ENTITY_POWERUP) dodged++;  // Missed power-ups don't score
+            despawnEntity(entities, i);
+            continue;
+        }
+        entities->column[i] -= entities->velocity_x[i];
+
+        // Vertical movers bounce off the top and bottom positions
+        if (entities->velocity_y[i] != 0) {
+            int8_t position = entities->position[i] + entities->velocity_y[i];
+            if (position < 0 || position >= SPACESHIP_POSITION_COUNT) {
+                entities->velocity_y[i] = -entities->velocity_y[i];
+                position = entities->position[i] + entities->velocity_y[i];
+            }
+            entities->position[i] = position;
+        }
+    }
+
+    rasterizeEntities(game);
+
+    if (dodged > 0) {
+        game->blocks_dodged += dodged;
+        game->score += 10 * game->level * dodged;
+    }
+}
+
+static void checkCollisions(GameState* game) {
+    EntityPool* entities = &game->entities;
+    // Check collision with spaceship (column 0)
+    uint8_t spaceship_mask = 0x01 << game->spaceship_position;
+
+    // The bitboards tell whether anything is hit; only then look for which entities
+    if ((game->obstacles.column[0] | game->powerups.column[0]) & spaceship_mask) {
+        uint8_t hit_types = 0;
+        EntityMask remaining = entities->live;
+
+        while (remaining) {
+            uint8_t i = nextEntity(&remaining);
+            if (ENTITY_COLUMN(entities, i) != 0) continue;
+            if (!(entityShape(entities->type[i], entities->position[i]) & spaceship_mask)) continue;
+
+            hit_types |= 0x01 << entities->type[i];
+            despawnEntity(entities, i);  // Remove the collided entity
+        }
+        rasterizeEntities(game);
+
+        if (hit_types & (0x01 << ENTITY_POWERUP)) {
+            collectPowerup(game);
+        }
+        if (hit_types & ~(0x01 << ENTITY_POWERUP)) {
+            loseLife(game);  // At most one life per tick, even if several obstacles overlap
+        }
+    }
+
+    // Check game over condition
+    if (game->lives == 0) {
+        game->game_running = 0;
+    }
+}
+
+static void loseLife(GameState* game) {
+    #ifdef ENTITY_STRESS_TEST
+    return;  // Stay alive so the pool stays full
+    #endif
+    if (game->lives == 0) return;
+
+    // Collision detected!
+    game->lives--;
+    halFlashShip();
+
+    // Turn off one LED
+    halSetLed(game->lives, 0);
+
+    // Play buzzer sound when losing a life
+    halPlaySound(GAME_SOUND_COLLISION);
+
+    halReportCollision(game->lives, game->spaceship_position, TELEMETRY_HIT_OBSTACLE);
+}
+
+static void collectPowerup(GameState* game) {
+    if (game->lives >= MAX_LIVES) return;
+
+    // Turn the LED of the restored life back on
+    halSetLed(game->lives, 1);
+    game->lives++;
+
+    halPlaySound(GAME_SOUND_POWERUP);
+
+    halReportCollision(game->lives, game->spaceship_position, TELEMETRY_HIT_POWERUP);
+}
+
+// Spawns an entity at the rightmost column; returns its slot or ENTITY_NONE
+static uint8_t addBlock(GameState* game, uint8_t type, uint8_t position, uint8_t velocity_x, int8_t velocity_y) {
+    uint8_t entity = spawnEntity(&game->entities, type, DISPLAY_WIDTH - 1, position, velocity_x, velocity_y);
+    if (entity == ENTITY_NONE) {
+        game->spawns_dropped++;
+        return ENTITY_NONE;
+    }
+    rasterizeEntity(game, entity);
+    return entity;
+}
+
+// Segments covered by an entity of this type at this position
+static uint8_t entityShape(uint8_t type, uint8_t position) {
+    if (type == ENTITY_WALL) {
+        return (uint8_t)(((1 << WALL_HEIGHT) - 1) << position);
+    }
+    return 0x01 << position;
+}
+
+static void rasterizeEntity(GameState* game, uint8_t entity) {
+    EntityPool* entities = &game->entities;
+    uint8_t column = ENTITY_COLUMN(entities, entity);
+    uint8_t shape = entityShape(entities->type[entity], entities->position[entity]);
+
+    if (entities->type[entity] == ENTITY_POWERUP) {
+        game->powerups.column[column] |= shape;
+    } else {
+        game->obstacles.column[column] |= shape;
+    }
+}
+
+static void rasterizeEntities(GameState* game) {
+    game->obstacles.all = 0;
+    game->powerups.all = 0;
+
+    EntityMask remaining = game->entities.live;
+    while (remaining) {
+        rasterizeEntity(game, nextEntity(&remaining));
+    }
+}
@@ -0,0 +1,115 @@
+/* Audiosurf game core: the simulation, with no hardware in it.
+
+   State, spawning (random, from a beatmap or from the host's stream),
+   movement, collisions, scoring and level progression. The platform calls
+   gameTick() once per game tick and gameMoveShip() for every move in between,
+   and draws the playfield bitboards; whatever the game does to the outside
+   world (LEDs, sounds, tick period, serial) goes through game_hal.h.
+
+   Nothing here reads a clock or an input: the same seed, level, block source
+   and moves at the same ticks play out the same game on the board and in the
+   native build (pio run -e native).
+ */
+#ifndef GAME_H
+#define GAME_H
+
+#include <stdint.h>
+#include "entities.h"
+#include "rng.h"
+#include "beatmap.h"
+
+// Game configuration
+#define MAX_LEVEL 10
+#define INITIAL_LEVEL 1
+#define MAX_LIVES 4
+#define DISPLAY_WIDTH 4
+#define SPACESHIP_POSITION_COUNT 8
+#define SPACESHIP_START_POSITION 4  // Middle position
+#define BLOCK_SPAWN_PROBABILITY 30  // Percentage chance per level
+#define BASE_GAME_SPEED 800  // Base speed in milliseconds (reduced from 2000 for faster movement)
+#define MIN_GAME_SPEED 150  // Fastest game tick in milliseconds
+
+// Obstacle kinds (entity types)
+#define ENTITY_BLOCK 0    // One cell
+#define ENTITY_WALL 1     // WALL_HEIGHT cells stacked up from its position
+#define ENTITY_POWERUP 2  // Restores a life when caught
+#define WALL_HEIGHT 3
+#define WALL_MIN_LEVEL 3  // Walls appear from this level on
+#define DRIFT_MIN_LEVEL 5  // Obstacles start moving vertically from this level on
+#define POWERUP_CHANCE 4  // Percentage of spawns that are power-ups (only while a life is missing)
+#define WALL_CHANCE 15  // Percentage of spawns that are walls
+#define SLOW_CHANCE 25  // Percentage of spawns that move at half speed
+#define SPEED_NORMAL ENTITY_SUBSTEPS  // One column per game tick
+#define SPEED_SLOW (ENTITY_SUBSTEPS / 2)  // One column every two game ticks
+
+// Where a game's blocks come from ("map" command)
+#define BLOCKS_RANDOM 0   // The seeded generator, harder with every level
+#define BLOCKS_BEATMAP 1  // A beatmap in flash, then random
+#define BLOCKS_STREAM 2   // Beatmap events streamed by the host, then random
+
+// Sound effects for halPlaySound()
+#define GAME_SOUND_LEVEL_UP 0
+#define GAME_SOUND_COLLISION 1
+#define GAME_SOUND_POWERUP 2
+
+// gameReplay() results
+#define GAME_REPLAY_MATCH 0      // Played to the recorded end with the recorded ticks and score
+#define GAME_REPLAY_MISMATCH 1   // Ended elsewhere: the core no longer plays that game the same
+#define GAME_REPLAY_TRUNCATED 2  // Played up to where the recording ran out of room
+#define GAME_REPLAY_INVALID 3    // Not a recording, or a damaged one
+#define GAME_REPLAY_STREAMED 4   // A recording of a game on the host's stream: its blocks are gone
+#define GAME_REPLAY_NO_MAP 5     // A beatmap game, and map is not a beatmap
+
+// Beatmap events carry the entity type as is
+#if BEATMAP_BLOCK != ENTITY_BLOCK || BEATMAP_WALL != ENTITY_WALL || BEATMAP_POWERUP != ENTITY_POWERUP
+#error "beatmap kinds must match the entity types"
+#endif
+#if BEATMAP_WALL_MAX_POSITION != SPACESHIP_POSITION_COUNT - WALL_HEIGHT
+#error "beatmap walls must fit the display"
+#endif
+
+// Playfield bitboard: one byte per display column, bit n = cell at position n.
+// Column 0 (the spaceship column) is the low byte (AVR is little-endian).
+// The bitboards are a rasterized view of the entity pool, rebuilt every tick,
+// so collision tests and rendering never have to look at entities.
+typedef union {
+    uint32_t all;
+    uint8_t column[DISPLAY_WIDTH];
+} Playfield;
+
+typedef struct {
+    uint8_t level;
+    uint8_t lives;
+    uint8_t spaceship_position;  // 0-7 for 8-segment display positions
+    uint16_t score;
+    uint8_t game_running;
+    unsigned long blocks_dodged;  // Changed to unsigned long to match printf format
+    uint16_t seed;  // Replaying a seed replays the same blocks
+    Rng rng;        // Block generator, only used for spawning
+    uint16_t ticks;              // Game ticks since the game started
+    EntityPool entities;         // Every obstacle and power-up, no heap use
+    Playfield obstacles;         // Cells that cost a life
+    Playfield powerups;          // Cells that restore a life
+    uint16_t spawns_dropped;     // Spawns lost because the entity pool was full
+    uint8_t block_source;        // Falls back to BLOCKS_RANDOM when the map ends
+    BeatmapReader beatmap;       // Spawns blocks to the song while block_source is BLOCKS_BEATMAP
+} GameState;
+
+void gameInit(GameState* game);  // level 1, full lives, empty playfield, random blocks
+void gameSeed(GameState* game, uint16_t seed);  // restarts the block sequence
+uint8_t gameUseBeatmap(GameState* game, PGM_P map);  // 0 if map is not a beatmap
+void gameUseStream(GameState* game);  // the beatstream queue must have started
+void gameTick(GameState* game);  // move, spawn, collide, level up
+void gameMoveShip(GameState* game, uint8_t position);  // and check for a hit right away
+void gameFinish(GameState* game);  // final score
+void gameClear(GameState* game);  // removes every block
+
+// Plays a recording (see replay.h) as fast as it goes: the same moves and commands
+// at the same ticks. map is the beatmap for recordings of BLOCKS_BEATMAP games.
+uint8_t gameReplay(GameState* game, const uint8_t* recording, uint16_t size, PGM_P map);
+
+uint16_t gameSpeedForLevel(uint8_t level);
+uint16_t gameTickPeriod(const GameState* game);  // beatmap tempo while one plays, else the level's
+uint16_t calculateScore(uint8_t level, unsigned long blocks_dodged);
+
+#endif
@@ -0,0 +1,23 @@
+/* What the game core (game.h) needs from the platform.
+
+   src/main.c implements these with the shield libraries; the native runner
+   (src/native/) with counters. The display, buttons and potentiometer are
+   not here: the platform draws the playfield bitboards itself and turns its
+   input into gameMoveShip() calls. Everything is called from gameTick() or
+   gameMoveShip(), so never from an interrupt.
+ */
+#ifndef GAME_HAL_H
+#define GAME_HAL_H
+
+#include <stdint.h>
+
+void halSetLed(uint8_t led, uint8_t on);     // life LEDs, 0 to MAX_LIVES - 1
+void halPlaySound(uint8_t sound);            // GAME_SOUND_*, may be dropped
+void halFlashShip(void);                     // a life was lost: blink the ship for a while
+void halSetTickPeriod(uint16_t ms);          // game ticks come every ms from the next one on
+void halPrint_P(const char* text);           // status text, a flash string
+void halReportCollision(uint8_t lives, uint8_t position, uint8_t kind);  // TELEMETRY_HIT_*
+void halReportLevelUp(uint8_t level, uint16_t period);
+void halReportStream(void);                  // a streamed tick was played: send the queue state
+
+#endif
@@ -1,6 +1,17 @@
 #include <avr/io.h>
+#include <avr/interrupt.h>
 #include <stdint.h>
 #include <usart.h>
+#include "potentiometer.h"
+
+static uint16_t sample_sum = 0;
+static uint8_t sample_count = 0;
+static uint32_t average = 0;  // EMA of the sums, times 2^POT_FILTER_SHIFT
+static uint8_t filter_started = 0;
+static volatile uint16_t noise = 0;  // raw conversions, rotated and xored together
+
+static volatile uint16_t published = 0;      // 0-1023
+static volatile uint8_t publish_count = 0;   // bumped after every write of published
 
 //code from canvas
 void initADC()
@@ -12,12 +23,58 @@ void initADC()
     ADCSRA |= ( 1 << ADPS2 ) | ( 1 << ADPS1 ) | ( 1 << ADPS0 );  
                                 //Determine a sample rate by setting a division factor. 
                                 //Used division factor: 128
-    ADCSRA |= ( 1 << ADEN ); //Enable the ADC
+    DIDR0 |= ( 1 << ADC0D );    //PC0 is analog only: switch off its digital input buffer
+    ADCSRB = 0;                 //Auto trigger source: free running
+    ADCSRA |= ( 1 << ADEN ) | ( 1 << ADATE ) | ( 1 << ADIE ); //Enable the ADC, auto trigger, interrupt
+    ADCSRA |= ( 1 << ADSC );    //First conversion; the following ones start by themselves
+}
+
+ISR(ADC_vect) {
+    uint16_t sample = ADC;
+    noise = ((noise << 1) | (noise >> 15)) ^ sample;
+    sample_sum += sample;
+    if (++sample_count < POT_OVERSAMPLE) return;
+
+    if (!filter_started) {
+        average = (uint32_t)sample_sum << POT_FILTER_SHIFT;  // start from the first reading
+    } else {
+        average = average - (average >> POT_FILTER_SHIFT) + sample_sum;
+    }
+    sample_sum = 0;
+    sample_count = 0;
+
+    // Average in 0-1023 steps, rounded
+    uint16_t value = ((average >> POT_FILTER_SHIFT) + POT_OVERSAMPLE / 2) / POT_OVERSAMPLE;
+    if (value > 1023) value = 1023;
+    uint16_t distance = value > published ? value - published : published - value;
+    if (distance > POT_HYSTERESIS || !filter_started
+        || (value != published && (value == 0 || value == 1023))) {  // still reach both ends
+        published = value;
+        publish_count++;
+        filter_started = 1;
+    }
 }
 
 uint16_t readADC() {
-    ADCSRA |= (1 << ADSC);                  // Start ADC conversion
-    loop_until_bit_is_clear(ADCSRA, ADSC);  // Wait until done
-    uint16_t seed = ADC;                    // Read result from A0
-    return seed;
-}
\ No newline at end of file
+    // Lock-free: the ISR cannot run in the middle of itself, so if the count is
+    // the same before and after reading, both bytes of the value belong together
+    uint8_t count;
+    uint16_t value;
+    do {
+        count = publish_count;
+        value = published;
+    } while (count != publish_count);
+    return value;
+}
+
+uint8_t potScale(uint8_t steps) {
+    return ((uint32_t)readADC() * steps) >> 10;
+}
+
+uint8_t potChanges(void) {
+    return publish_count;
+}
+
+uint16_t potNoise(void) {
+    return noise;  // a torn read is as random as a whole one
+}
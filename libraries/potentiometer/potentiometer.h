@@ -1,2 +1,29 @@
+#ifndef POTENTIOMETER_H
+#define POTENTIOMETER_H
+
+#include <stdint.h>
+
+/* The ADC converts A0 (PC0) continuously in free-running mode, ~9.6 kHz at
+   prescaler 128. ADC_vect sums POT_OVERSAMPLE conversions, smooths the sums
+   with an exponential moving average (weight 1/2^POT_FILTER_SHIFT, ~13 ms)
+   and publishes a new 0-1023 value only once the average has moved more than
+   POT_HYSTERESIS steps from the published one, so noise never makes it flicker.
+   Readers never wait for a conversion and never disable interrupts. */
+#define POT_OVERSAMPLE 16     // conversions per filter update (600 Hz)
+#define POT_FILTER_SHIFT 3
+#define POT_HYSTERESIS 3      // in 0-1023 steps
+
 void initADC();
-uint16_t readADC();
\ No newline at end of file
+/* Starts the free-running conversions; needs interrupts enabled */
+uint16_t readADC();
+/* Latest published value, 0-1023. Returns at once (it used to wait ~100 us) */
+uint8_t potScale(uint8_t steps);
+/* Latest value mapped to 0..steps-1 */
+uint8_t potChanges(void);
+/* Moves on every time a new value is published: compare with an earlier
+   result to see whether the value may have changed */
+uint16_t potNoise(void);
+/* Every raw conversion rotated into 16 bits: the low bits carry the ADC noise.
+   An entropy source for seeding, not a measurement */
+
+#endif
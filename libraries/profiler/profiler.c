@@ -0,0 +1,259 @@
+#include "profiler.h"
+
+#if PROFILER_ENABLED
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <util/atomic.h>
+#include <avr/pgmspace.h>
+#include <usart.h>
+#include <format.h>
+
+typedef struct {
+    uint16_t count;
+    uint32_t min;
+    uint32_t max;
+    uint32_t sum;
+} ProfileSlot;
+
+typedef struct {
+    uint16_t bucket[PROFILER_LATENCY_BUCKETS];
+    uint16_t max;
+} LatencyHistogram;
+
+static ProfileSlot slots[PROF_SLOT_COUNT];
+static LatencyHistogram latencies[PROF_LATENCY_COUNT];
+static volatile uint16_t overflows = 0;
+static uint8_t overhead = 0;  // cost of an empty BEGIN/END pair, in counts
+static volatile uint8_t suspended = 0;  // sections end unrecorded
+
+// Main loop time per phase since the last reset (counts wrap after 35 minutes)
+static uint32_t phase_time[PROF_PHASE_COUNT];
+static uint32_t phase_idle[PROF_PHASE_COUNT];
+static uint8_t phase = PROF_PHASE_MENU;
+static uint32_t phase_start = 0;
+
+#define PROFILER_COUNTS_PER_MS (F_CPU / PROFILER_CYCLES_PER_COUNT / 1000UL)
+
+#define SLOT_NAME_LENGTH 18
+
+static const char slot_names[PROF_SLOT_COUNT][SLOT_NAME_LENGTH] PROGMEM = {
+    "TIMER1_COMPA_vect",
+    "TIMER1_COMPB_vect",
+    "buttonSample",
+    "moveBlocks",
+    "spawnBlocks",
+    "checkCollisions",
+    "displayGameInfo",
+    "renderDisplay",
+    "updateGame",
+    "wake: game tick",
+    "wake: refresh",
+};
+
+static const char latency_names[PROF_LATENCY_COUNT][SLOT_NAME_LENGTH] PROGMEM = {
+    "press to patch",
+    "press to frame",
+};
+
+static const char phase_names[PROF_PHASE_COUNT][SLOT_NAME_LENGTH] PROGMEM = {
+    "menu",
+    "play",
+    "game over",
+};
+
+ISR(TIMER1_OVF_vect) {
+    overflows++;
+}
+
+void initProfiler(void) {
+    TIFR1 = (1 << TOV1);      // drop a stale overflow flag
+    TIMSK1 |= (1 << TOIE1);
+
+    // Calibrate: whatever an empty pair measures is subtracted from every sample
+    uint32_t start = profilerNow();
+    uint32_t empty = profilerNow() - start;
+    overhead = empty > 255 ? 255 : empty;
+
+    profilerReset();
+}
+
+uint32_t profilerNow(void) {
+    uint16_t low;
+    uint16_t high;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        low = TCNT1;
+        high = overflows;
+        // Overflow happened but its interrupt hasn't run yet (or can't, we're in an ISR)
+        if ((TIFR1 & (1 << TOV1)) && low < 0x8000) {
+            high++;
+        }
+    }
+    return ((uint32_t)high << 16) | low;
+}
+
+void profilerRecord(uint8_t slot, uint32_t counts) {
+    if (slot >= PROF_SLOT_COUNT || suspended) return;
+    counts = counts > overhead ? counts - overhead : 0;
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        ProfileSlot* s = &slots[slot];
+        if (s->count == 0xFFFF) return;  // saturated, keep the statistics as they are
+        if (counts < s->min) s->min = counts;
+        if (counts > s->max) s->max = counts;
+        s->sum += counts;
+        s->count++;
+    }
+}
+
+void profilerSuspend(uint8_t on) {
+    suspended = on;
+}
+
+void profilerLatency(uint8_t histogram, uint16_t ms) {
+    if (histogram >= PROF_LATENCY_COUNT) return;
+
+    // Bucket = number of significant bits, merging 0 and 1 ms
+    uint8_t bucket = 0;
+    for (uint16_t rest = ms >> 1; rest != 0 && bucket < PROFILER_LATENCY_BUCKETS - 1; rest >>= 1) {
+        bucket++;
+    }
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        LatencyHistogram* h = &latencies[histogram];
+        if (h->bucket[bucket] != 0xFFFF) h->bucket[bucket]++;
+        if (ms > h->max) h->max = ms;
+    }
+}
+
+void profilerPhase(uint8_t next) {
+    if (next >= PROF_PHASE_COUNT) return;
+    uint32_t now = profilerNow();
+    phase_time[phase] += now - phase_start;
+    phase_start = now;
+    phase = next;
+}
+
+void profilerIdle(uint32_t counts) {
+    phase_idle[phase] += counts;
+}
+
+void profilerReset(void) {
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        for (uint8_t i = 0; i < PROF_SLOT_COUNT; i++) {
+            slots[i].count = 0;
+            slots[i].min = 0xFFFFFFFF;
+            slots[i].max = 0;
+            slots[i].sum = 0;
+        }
+        for (uint8_t i = 0; i < PROF_LATENCY_COUNT; i++) {
+            for (uint8_t b = 0; b < PROFILER_LATENCY_BUCKETS; b++) {
+                latencies[i].bucket[b] = 0;
+            }
+            latencies[i].max = 0;
+        }
+    }
+    for (uint8_t i = 0; i < PROF_PHASE_COUNT; i++) {
+        phase_time[i] = 0;
+        phase_idle[i] = 0;
+    }
+    phase_start = profilerNow();
+}
+
+// Each table is a title, a header and one line per row
+static void reportSlotLine(uint8_t line) {
+    if (line == 0) {
+        printString_P(PSTR("\n=== PROFILE (cycles) ===\n"));
+        return;
+    }
+    if (line == 1) {
+        printString_P(PSTR("section             count      min     mean      max\n"));
+        return;
+    }
+    ProfileSlot s;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        s = slots[line - 2];
+    }
+    printPadded_P(slot_names[line - 2], SLOT_NAME_LENGTH);
+    printU32Right(s.count, 7);
+    if (s.count == 0) {
+        printString_P(PSTR("        -        -        -\n"));
+        return;
+    }
+    printU32Right(s.min * PROFILER_CYCLES_PER_COUNT, 9);
+    printU32Right((s.sum / s.count) * PROFILER_CYCLES_PER_COUNT, 9);
+    printU32Right(s.max * PROFILER_CYCLES_PER_COUNT, 9);
+    transmitByte('\n');
+}
+
+static void reportLatencyLine(uint8_t line) {
+    if (line == 0) {
+        printString_P(PSTR("\n=== LATENCY (ms) ===\n"));
+        return;
+    }
+    if (line == 1) {
+        printString_P(PSTR("section              0-1   2-3   4-7  8-15 16-31 32-63 64-127  128+   max\n"));
+        return;
+    }
+    LatencyHistogram h;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        h = latencies[line - 2];
+    }
+    printPadded_P(latency_names[line - 2], SLOT_NAME_LENGTH);
+    for (uint8_t b = 0; b < PROFILER_LATENCY_BUCKETS; b++) {
+        printU32Right(h.bucket[b], b == PROFILER_LATENCY_BUCKETS - 2 ? 7 : 6);
+    }
+    printU32Right(h.max, 6);
+    transmitByte('\n');
+}
+
+static void reportPhaseLine(uint8_t line) {
+    if (line == 0) {
+        printString_P(PSTR("\n=== MAIN LOOP ===\n"));
+        return;
+    }
+    if (line == 1) {
+        printString_P(PSTR("phase             time (ms)    idle\n"));
+        return;
+    }
+    uint8_t i = line - 2;
+    uint32_t time = phase_time[i];
+    if (i == phase) time += profilerNow() - phase_start;
+    printPadded_P(phase_names[i], SLOT_NAME_LENGTH);
+    printU32Right(time / PROFILER_COUNTS_PER_MS, 9);
+    if (time < 1000) {
+        printString_P(PSTR("       -\n"));
+        return;
+    }
+    uint32_t permille = phase_idle[i] / (time / 1000);
+    printU32Right(permille / 10, 5);
+    transmitByte('.');
+    transmitByte('0' + permille % 10);
+    printString_P(PSTR("%\n"));
+}
+
+uint8_t profilerReportLine(uint8_t line) {
+    if (line < 2 + PROF_SLOT_COUNT) {
+        reportSlotLine(line);
+        return 1;
+    }
+    line -= 2 + PROF_SLOT_COUNT;
+    if (line < 2 + PROF_LATENCY_COUNT) {
+        reportLatencyLine(line);
+        return 1;
+    }
+    line -= 2 + PROF_LATENCY_COUNT;
+    if (line < 2 + PROF_PHASE_COUNT) {
+        reportPhaseLine(line);
+        return 1;
+    }
+    return 0;
+}
+
+void profilerReport(void) {
+    for (uint8_t line = 0; profilerReportLine(line); line++) {
+    }
+}
+
+
+#endif
@@ -0,0 +1,102 @@
+/* Cycle profiler for interrupts and game loop phases.
+
+   Timestamps come from Timer1, which free-runs at F_CPU/8, extended to 32 bits
+   by counting overflows. Every slot keeps count/min/max/sum in fixed RAM, and
+   profilerReport() prints them over USART in CPU cycles.
+
+   Latency histograms count millisecond delays (input to display) in
+   power-of-two buckets: 0-1, 2-3, 4-7, ... 64-127 and 128+ ms.
+
+   The main loop tells the profiler which phase of the game it is in and how
+   long it waited for work (asleep, or in interrupts that left it none), and
+   the report gives the idle fraction of each phase.
+
+   Build with -D PROFILER_ENABLED=1 (the uno_profile environment) to turn it on.
+   Otherwise every macro below expands to nothing and no code or RAM is used.
+ */
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <stdint.h>
+
+#ifndef PROFILER_ENABLED
+#define PROFILER_ENABLED 0
+#endif
+
+#define PROFILER_CYCLES_PER_COUNT 8  /* Timer1 prescaler */
+
+/* One slot per measured section */
+enum {
+    PROF_TIMER_ISR,
+    PROF_DISPLAY_PLANE,
+    PROF_BUTTON_SAMPLE,
+    PROF_MOVE_BLOCKS,
+    PROF_SPAWN_BLOCKS,
+    PROF_CHECK_COLLISIONS,
+    PROF_GAME_INFO,
+    PROF_RENDER,
+    PROF_GAME_TICK,
+    PROF_WAKE_TICK,     /* game tick flag set to updateGame() starting */
+    PROF_WAKE_REFRESH,  /* refresh flag set to renderDisplay() starting */
+    PROF_SLOT_COUNT
+};
+
+/* One histogram per measured latency */
+enum {
+    PROF_LATENCY_PATCH,  /* button press to ship shown by the fast path */
+    PROF_LATENCY_FRAME,  /* button press to the first full frame showing it */
+    PROF_LATENCY_COUNT
+};
+
+#define PROFILER_LATENCY_BUCKETS 8
+
+/* Main loop phases for the idle report */
+enum {
+    PROF_PHASE_MENU,       /* tutorial and level selection */
+    PROF_PHASE_PLAY,
+    PROF_PHASE_GAME_OVER,  /* until the next game starts */
+    PROF_PHASE_COUNT
+};
+
+#if PROFILER_ENABLED
+
+void initProfiler(void);                    /* call after Timer1 is running */
+uint32_t profilerNow(void);                 /* Timer1 counts, 32-bit */
+void profilerRecord(uint8_t slot, uint32_t counts);
+void profilerLatency(uint8_t histogram, uint16_t ms);  /* safe from ISRs */
+void profilerPhase(uint8_t phase);          /* main loop only */
+void profilerIdle(uint32_t counts);         /* main loop only: it waited this long */
+void profilerReset(void);
+void profilerSuspend(uint8_t on);           /* 1: nothing is recorded until 0 */
+void profilerReport(void);
+uint8_t profilerReportLine(uint8_t line);   /* one line of the report; 0 past the last */
+
+#define PROFILE_BEGIN(slot) uint32_t profile_start_##slot = profilerNow()
+#define PROFILE_END(slot) profilerRecord((slot), profilerNow() - profile_start_##slot)
+
+/* Sections that start in one place (an ISR) and end in another: the start
+   goes into a uint32_t that only exists in profiled builds */
+#define PROFILE_MARK(mark) ((mark) = profilerNow())
+#define PROFILE_SINCE(slot, mark) profilerRecord((slot), profilerNow() - (mark))
+#define PROFILE_IDLE_BEGIN() uint32_t profile_idle_start = profilerNow()
+#define PROFILE_IDLE_END() profilerIdle(profilerNow() - profile_idle_start)
+
+#else
+
+#define initProfiler() do {} while (0)
+#define profilerReset() do {} while (0)
+#define profilerSuspend(on) do {} while (0)
+#define profilerReport() do {} while (0)
+#define profilerReportLine(line) 0
+#define profilerLatency(histogram, ms) do {} while (0)
+#define profilerPhase(phase) do {} while (0)
+#define PROFILE_BEGIN(slot) do {} while (0)
+#define PROFILE_END(slot) do {} while (0)
+#define PROFILE_MARK(mark) do {} while (0)
+#define PROFILE_SINCE(slot, mark) do {} while (0)
+#define PROFILE_IDLE_BEGIN() do {} while (0)
+#define PROFILE_IDLE_END() do {} while (0)
+
+#endif
+
+#endif
@@ -0,0 +1,159 @@
+#include <stdint.h>
+#include "replay.h"
+
+static void putWord(uint8_t* at, uint16_t value) {
+    at[0] = value & 0xFF;
+    at[1] = value >> 8;
+}
+
+static uint16_t getWord(const uint8_t* at) {
+    return at[0] | ((uint16_t)at[1] << 8);
+}
+
+static uint8_t* putVarint(uint8_t* at, uint32_t value) {
+    while (value >= 0x80) {
+        *at++ = (value & 0x7F) | 0x80;
+        value >>= 7;
+    }
+    *at++ = value;
+    return at;
+}
+
+/* 0 if the varint runs past end or is longer than 3 bytes (21 bits) */
+static uint8_t getVarint(ReplayReader* reader, uint32_t* value) {
+    uint8_t shift = 0;
+    uint8_t byte;
+    *value = 0;
+    do {
+        if (reader->next == reader->end || shift == 21) return 0;
+        byte = *reader->next++;
+        *value |= (uint32_t)(byte & 0x7F) << shift;
+        shift += 7;
+    } while (byte & 0x80);
+    return 1;
+}
+
+/* Fletcher-16 of everything but the check word itself */
+static uint16_t checkRecording(const uint8_t* data, uint16_t size) {
+    uint16_t sum1 = 0;
+    uint16_t sum2 = 0;
+    for (uint16_t i = 0; i < size; i++) {
+        if (i == REPLAY_CHECK_OFFSET || i == REPLAY_CHECK_OFFSET + 1) continue;
+        sum1 += data[i];
+        if (sum1 >= 255) sum1 -= 255;  /* both stay below 255: no division */
+        sum2 += sum1;
+        if (sum2 >= 255) sum2 -= 255;
+    }
+    return (sum2 << 8) | sum1;
+}
+
+void replayBegin(ReplayWriter* writer, uint8_t* data, uint16_t size, uint16_t seed, uint8_t level,
+                 uint8_t source, uint8_t position) {
+    writer->data = data;
+    writer->size = size;
+    writer->length = REPLAY_HEADER_SIZE;
+    writer->tick = 0;
+    writer->position = position;
+    writer->flags = 0;
+    data[0] = REPLAY_MAGIC_0;
+    data[1] = REPLAY_MAGIC_1;
+    data[2] = REPLAY_VERSION;
+    data[4] = source;
+    data[5] = level;
+    putWord(data + 6, seed);
+}
+
+/* Room for the longest event, or the recording is truncated from here on */
+static uint8_t* reserve(ReplayWriter* writer, uint16_t tick) {
+    if (writer->flags & REPLAY_TRUNCATED) return 0;
+    if (writer->size - writer->length < REPLAY_MAX_EVENT) {
+        writer->flags |= REPLAY_TRUNCATED;
+        writer->tick = tick;
+        return 0;
+    }
+    return writer->data + writer->length;
+}
+
+static uint8_t* putDelta(ReplayWriter* writer, uint8_t* at, uint16_t tick, uint8_t kind) {
+    at = putVarint(at, ((uint32_t)(uint16_t)(tick - writer->tick) << 2) | kind);
+    writer->tick = tick;
+    return at;
+}
+
+void replayMove(ReplayWriter* writer, uint16_t tick, uint8_t position) {
+    uint8_t* at = reserve(writer, tick);
+    if (at == 0) return;
+
+    if (position + 1 == writer->position) {
+        at = putDelta(writer, at, tick, REPLAY_UP);
+    } else if (position == writer->position + 1) {
+        at = putDelta(writer, at, tick, REPLAY_DOWN);
+    } else {
+        at = putDelta(writer, at, tick, REPLAY_MOVE);
+        *at++ = position;
+    }
+    writer->position = position;
+    writer->length = at - writer->data;
+}
+
+void replaySet(ReplayWriter* writer, uint16_t tick, uint8_t what, uint16_t value) {
+    uint8_t* at = reserve(writer, tick);
+    if (at == 0) return;
+
+    at = putDelta(writer, at, tick, REPLAY_SET);
+    *at++ = what;
+    at = putVarint(at, value);
+    writer->length = at - writer->data;
+}
+
+uint16_t replayEnd(ReplayWriter* writer, uint16_t ticks, uint16_t score) {
+    uint8_t* data = writer->data;
+    data[3] = writer->flags;
+    putWord(data + 8, writer->length - REPLAY_HEADER_SIZE);
+    putWord(data + 10, (writer->flags & REPLAY_TRUNCATED) ? writer->tick : ticks);
+    putWord(data + 12, score);
+    putWord(data + REPLAY_CHECK_OFFSET, checkRecording(data, writer->length));
+    return writer->length;
+}
+
+uint16_t replaySize(const uint8_t* data) {
+    if (data[0] != REPLAY_MAGIC_0 || data[1] != REPLAY_MAGIC_1 || data[2] != REPLAY_VERSION) return 0;
+    return REPLAY_HEADER_SIZE + getWord(data + 8);
+}
+
+uint8_t replayOpen(ReplayReader* reader, ReplayHeader* header, const uint8_t* data, uint16_t size) {
+    if (size < REPLAY_HEADER_SIZE || replaySize(data) != size) return 0;
+    if (checkRecording(data, size) != getWord(data + REPLAY_CHECK_OFFSET)) return 0;
+
+    header->flags = data[3];
+    header->source = data[4];
+    header->level = data[5];
+    header->seed = getWord(data + 6);
+    header->ticks = getWord(data + 10);
+    header->score = getWord(data + 12);
+    reader->next = data + REPLAY_HEADER_SIZE;
+    reader->end = data + size;
+    reader->tick = 0;
+    return 1;
+}
+
+uint8_t replayNext(ReplayReader* reader, ReplayEvent* event) {
+    uint32_t delta;
+    uint32_t value = 0;
+    if (!getVarint(reader, &delta)) return 0;
+
+    event->kind = delta & 0x03;
+    event->what = 0;
+    if (event->kind == REPLAY_MOVE) {
+        if (reader->next == reader->end) return 0;
+        value = *reader->next++;
+    } else if (event->kind == REPLAY_SET) {
+        if (reader->next == reader->end) return 0;
+        event->what = *reader->next++;
+        if (!getVarint(reader, &value)) return 0;
+    }
+    reader->tick += delta >> 2;
+    event->tick = reader->tick;
+    event->value = value;
+    return 1;
+}
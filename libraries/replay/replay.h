@@ -0,0 +1,67 @@
+/* Game recorder and reader (see replay_format.h).
+
+   The writer appends each input to a RAM buffer as it happens: a varint
+   or two, O(1), never a write to EEPROM. When the buffer is full the rest
+   of the game is dropped and the recording says so. replayEnd() fills in
+   the header, and the buffer is ready to be stored as is.
+
+   The reader walks a recording in RAM, one event at a time:
+     ReplayEvent event;
+     while (replayNext(&reader, &event)) { ...apply it at event.tick... }
+
+   Plain C, no AVR headers: the native build reads the same recordings.
+ */
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#include <stdint.h>
+#include "replay_format.h"
+
+typedef struct {
+    uint8_t* data;      /* header, then the events */
+    uint16_t size;      /* bytes available at data */
+    uint16_t length;    /* bytes used, header included */
+    uint16_t tick;      /* of the last event (of the first lost one once truncated) */
+    uint8_t position;   /* ship position after the last event */
+    uint8_t flags;
+} ReplayWriter;
+
+typedef struct {
+    uint8_t flags;
+    uint8_t source;
+    uint8_t level;
+    uint16_t seed;
+    uint16_t ticks;
+    uint16_t score;
+} ReplayHeader;
+
+typedef struct {
+    const uint8_t* next;  /* first unread byte */
+    const uint8_t* end;
+    uint16_t tick;        /* of the last event read */
+} ReplayReader;
+
+typedef struct {
+    uint16_t tick;   /* game ticks played before it */
+    uint8_t kind;    /* REPLAY_UP, REPLAY_DOWN, REPLAY_MOVE or REPLAY_SET */
+    uint8_t what;    /* REPLAY_SET_*, for REPLAY_SET */
+    uint16_t value;  /* the position for REPLAY_MOVE, the value for REPLAY_SET */
+} ReplayEvent;
+
+/* Starts a recording in data (size bytes, at least REPLAY_HEADER_SIZE).
+   position is where the ship starts. */
+void replayBegin(ReplayWriter* writer, uint8_t* data, uint16_t size, uint16_t seed, uint8_t level,
+                 uint8_t source, uint8_t position);
+void replayMove(ReplayWriter* writer, uint16_t tick, uint8_t position);
+void replaySet(ReplayWriter* writer, uint16_t tick, uint8_t what, uint16_t value);
+/* Finishes the header; returns the recording's size in bytes */
+uint16_t replayEnd(ReplayWriter* writer, uint16_t ticks, uint16_t score);
+
+/* Size of the recording a header starts, or 0 if it isn't one (needs REPLAY_HEADER_SIZE bytes) */
+uint16_t replaySize(const uint8_t* data);
+/* Checks a whole recording and reads its header. Returns 0 if it is not a valid one. */
+uint8_t replayOpen(ReplayReader* reader, ReplayHeader* header, const uint8_t* data, uint16_t size);
+/* Takes the next event; 0 at the end */
+uint8_t replayNext(ReplayReader* reader, ReplayEvent* event);
+
+#endif
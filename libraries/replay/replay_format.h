@@ -0,0 +1,47 @@
+/* Game recording format, shared by the firmware and the native build.
+
+   A recording is a byte string (RAM while a game is played, EEPROM after it):
+
+     header   'R', 'P', version, flags, source, level, seed (u16),
+              events (u16), ticks (u16), score (u16), check (u16)
+     events   delta [, payload]   ... events bytes in all
+
+   delta    varint: (game ticks since the previous event << 2) | kind
+   kind     REPLAY_UP / REPLAY_DOWN: the ship moved one position, no payload
+            REPLAY_MOVE: one byte, the position the ship jumped to
+            REPLAY_SET: one byte, what was set (REPLAY_SET_*), and a varint value
+
+   Words are little endian, varints are little-endian base 128 as in
+   beatmap_format.h. Event times are game ticks played before the event, so
+   a move between ticks 4 and 5 is at tick 4; the first delta counts from 0.
+   source and level are what the game started with (source is the game's
+   BLOCKS_* value). ticks and score are the game's final ones; a recording
+   that ran out of room has REPLAY_TRUNCATED set and ticks is the tick it
+   lost its first event at. check is a Fletcher-16 sum of every other byte,
+   so a blank, half-written or foreign EEPROM is never played.
+
+   A move that follows the last one by a button press is one byte as long
+   as it comes within 31 ticks.
+ */
+#ifndef REPLAY_FORMAT_H
+#define REPLAY_FORMAT_H
+
+#define REPLAY_MAGIC_0 'R'
+#define REPLAY_MAGIC_1 'P'
+#define REPLAY_VERSION 1
+#define REPLAY_HEADER_SIZE 16
+#define REPLAY_CHECK_OFFSET 14
+
+#define REPLAY_TRUNCATED 0x01  /* flags: events after ticks were lost */
+
+#define REPLAY_UP 0    /* position - 1 */
+#define REPLAY_DOWN 1  /* position + 1 */
+#define REPLAY_MOVE 2
+#define REPLAY_SET 3
+
+#define REPLAY_SET_LEVEL 0  /* "level" command */
+#define REPLAY_SET_SEED 1   /* "seed" command */
+
+#define REPLAY_MAX_EVENT 7  /* bytes: 3 of delta, what, 3 of value */
+
+#endif
@@ -0,0 +1,31 @@
+#include <stdint.h>
+#include "rng.h"
+
+void rngSeed(Rng* rng, uint16_t seed) {
+    // Spread the 16 seed bits over the whole word, then skip the first steps:
+    // xorshift's first outputs from a sparse state are poor
+    rng->state = rngMix(0x6D2B79F5UL, seed);
+    if (rng->state == 0) rng->state = 0x6D2B79F5UL;
+    for (uint8_t i = 0; i < 4; i++) {
+        rngNext(rng);
+    }
+}
+
+uint32_t rngNext(Rng* rng) {
+    uint32_t x = rng->state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    rng->state = x;
+    return x;
+}
+
+uint32_t rngMix(uint32_t pool, uint16_t entropy) {
+    pool ^= entropy;
+    pool *= 0x9E3779B1UL;          // golden ratio: every input bit reaches the top
+    return (pool << 7) | (pool >> 25);
+}
+
+uint16_t rngFold(uint32_t pool) {
+    return (uint16_t)(pool >> 16) ^ (uint16_t)pool;
+}
@@ -0,0 +1,46 @@
+/* Small deterministic random number generator (xorshift32).
+
+   The whole state is one 32-bit word, so every game can carry its own
+   generator, and the same seed always gives the same sequence on any
+   machine: a game can be replayed or benchmarked from its seed.
+
+   Decisions use the top byte of each step with comparisons and a
+   multiply-shift instead of division: rngChance(rng, RNG_PERCENT(30)) is
+   true 30% of the time, rngBelow(rng, n) is uniform enough over 0..n-1
+   for small n. One step is about 80 cycles on AVR (rand() is over 1000).
+ */
+#ifndef RNG_H
+#define RNG_H
+
+#include <stdint.h>
+
+typedef struct {
+    uint32_t state;  /* never 0 */
+} Rng;
+
+/* Threshold for rngChance(), from a percentage (0-100) */
+#define RNG_PERCENT(percent) ((uint8_t)(((percent) * 256UL + 50) / 100 > 255 ? 255 : ((percent) * 256UL + 50) / 100))
+
+void rngSeed(Rng* rng, uint16_t seed);
+uint32_t rngNext(Rng* rng);
+
+/* Folds 16 bits of entropy (ADC noise, timer jitter) into a 32-bit pool.
+   Cheap enough for an ISR; the pool can be reduced with rngFold(). */
+uint32_t rngMix(uint32_t pool, uint16_t entropy);
+uint16_t rngFold(uint32_t pool);
+
+static inline uint8_t rngByte(Rng* rng) {
+    return rngNext(rng) >> 24;
+}
+
+/* 1 with probability threshold/256 */
+static inline uint8_t rngChance(Rng* rng, uint8_t threshold) {
+    return rngByte(rng) < threshold;
+}
+
+/* 0..n-1 */
+static inline uint8_t rngBelow(Rng* rng, uint8_t n) {
+    return ((uint16_t)rngByte(rng) * n) >> 8;
+}
+
+#endif
@@ -0,0 +1,67 @@
+#include <avr/io.h>
+#include <util/atomic.h>
+#include <stdint.h>
+#include "scheduler.h"
+
+// A countdown of 0 means the task is stopped. Both arrays are only touched
+// by the main program inside atomic blocks, so they don't need to be volatile.
+static uint16_t countdown[SCHEDULER_MAX_TASKS];
+static uint16_t reload[SCHEDULER_MAX_TASKS];
+static TaskCallback callbacks[SCHEDULER_MAX_TASKS];
+static uint8_t task_count = 0;
+
+uint8_t addTask(TaskCallback callback, uint16_t delay, uint16_t period) {
+    if (task_count >= SCHEDULER_MAX_TASKS || callback == 0) return SCHEDULER_NO_TASK;
+
+    uint8_t task = task_count;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        callbacks[task] = callback;
+        countdown[task] = delay;
+        reload[task] = period;
+        task_count++;  // published last so the ISR never sees a half-built slot
+    }
+    return task;
+}
+
+void restartTask(uint8_t task, uint16_t delay, uint16_t period) {
+    if (task >= task_count) return;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        countdown[task] = delay;
+        reload[task] = period;
+    }
+}
+
+void stopTask(uint8_t task) {
+    if (task >= task_count) return;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        countdown[task] = 0;
+    }
+}
+
+void shiftTask(uint8_t task, int16_t ticks) {
+    if (task >= task_count) return;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        if (countdown[task] != 0) {
+            int32_t next = (int32_t)countdown[task] + ticks;
+            countdown[task] = next < 1 ? 1 : next > 0xFFFF ? 0xFFFF : (uint16_t)next;
+        }
+    }
+}
+
+uint8_t taskActive(uint8_t task) {
+    uint8_t active = 0;
+    if (task >= task_count) return 0;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        active = countdown[task] != 0;
+    }
+    return active;
+}
+
+void schedulerTick(void) {
+    for (uint8_t i = 0; i < task_count; i++) {
+        if (countdown[i] != 0 && --countdown[i] == 0) {
+            countdown[i] = reload[i];  // 0 for one-shot tasks, which stops them
+            callbacks[i]();
+        }
+    }
+}
@@ -0,0 +1,34 @@
+/* Countdown scheduler driven from the 1 ms timer interrupt.
+
+   Every task gets its reload value when it is (re)armed, so the interrupt
+   only decrements counters - nothing is divided or recomputed per tick.
+   Callbacks run inside the ISR: keep them short (set a flag, step a column).
+ */
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <stdint.h>
+
+#define SCHEDULER_MAX_TASKS 8
+#define SCHEDULER_ONE_SHOT 0    /* period for tasks that fire once and stop */
+#define SCHEDULER_NO_TASK 0xFF  /* returned by addTask() when all slots are used */
+
+typedef void (*TaskCallback)(void);
+
+/* Registers a callback. A delay of 0 registers it stopped; arm it later with restartTask().
+   Returns the task handle or SCHEDULER_NO_TASK. */
+uint8_t addTask(TaskCallback callback, uint16_t delay, uint16_t period);
+
+/* (Re)arms a task to fire after delay ticks, then every period ticks. Safe from ISRs. */
+void restartTask(uint8_t task, uint16_t delay, uint16_t period);
+void stopTask(uint8_t task);
+
+/* Moves a running task's next run by ticks (later if positive, at least to the next tick),
+   keeping its period. Safe from ISRs. */
+void shiftTask(uint8_t task, int16_t ticks);
+uint8_t taskActive(uint8_t task);
+
+/* Call once per timer tick, from the timer interrupt */
+void schedulerTick(void);
+
+#endif
@@ -0,0 +1,55 @@
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <stdint.h>
+#include "storage.h"
+
+static const uint8_t* volatile write_data;  // next byte to write
+static volatile uint16_t write_address;
+static volatile uint16_t write_left = 0;    // bytes still to go; 0 when idle
+
+static uint8_t readByte(uint16_t address) {
+    EEAR = address;
+    EECR |= (1 << EERE);
+    return EEDR;
+}
+
+// Fires whenever the EEPROM is ready while EERIE is set: one byte per interrupt.
+// A byte that needs no write returns at once and the interrupt comes right back.
+ISR(EE_READY_vect) {
+    uint16_t address = write_address;
+    uint8_t value = *write_data;
+
+    if (readByte(address) != value) {
+        EEDR = value;  // EEAR still holds the address
+        EECR |= (1 << EEMPE);
+        EECR |= (1 << EEPE);  // Erase and write, must follow EEMPE within 4 cycles
+    }
+    write_data++;
+    write_address = address + 1;
+    if (--write_left == 0) {
+        EECR &= ~(1 << EERIE);
+    }
+}
+
+void storageWrite(uint16_t address, const uint8_t* data, uint16_t length) {
+    while (storageBusy()) {
+    }
+    if (length == 0) return;
+    write_data = data;
+    write_address = address;
+    write_left = length;
+    EECR |= (1 << EERIE);
+}
+
+uint8_t storageBusy(void) {
+    // EERIE is on while bytes are left to start, EEPE while the last one is programmed
+    return (EECR & ((1 << EERIE) | (1 << EEPE))) != 0;
+}
+
+void storageRead(uint16_t address, uint8_t* data, uint16_t length) {
+    while (storageBusy()) {
+    }
+    for (uint16_t i = 0; i < length; i++) {
+        data[i] = readByte(address + i);
+    }
+}
@@ -0,0 +1,22 @@
+#ifndef STORAGE_H
+#define STORAGE_H
+
+#include <stdint.h>
+
+/* EEPROM writes in the background. storageWrite() hands over a RAM buffer
+   and returns at once; EE_READY_vect then programs one byte per interrupt
+   (3.4 ms each) and skips the bytes that already hold their value, so no
+   one waits for the EEPROM and rewriting the same data wears nothing.
+   The buffer must stay untouched until storageBusy() returns 0; a reset
+   in between leaves the old and new bytes mixed, so data written this way
+   should carry a checksum. */
+#define STORAGE_SIZE 1024  // ATmega328P EEPROM bytes
+
+void storageWrite(uint16_t address, const uint8_t* data, uint16_t length);
+/* Starts writing length bytes at address; waits first if a write is still going on */
+uint8_t storageBusy(void);
+/* 1 from storageWrite() until the EEPE cycle of the last byte written has ended */
+void storageRead(uint16_t address, uint8_t* data, uint16_t length);
+/* Copies length bytes from address at once (after a write still going on) */
+
+#endif
@@ -0,0 +1,168 @@
+#include <stdint.h>
+#include <usart.h>
+#include <format.h>
+#include "telemetry.h"
+#include <util/crc16.h>
+
+static uint16_t frames_dropped = 0;
+
+static void putU16(uint8_t* out, uint16_t value) {
+    out[0] = value;
+    out[1] = value >> 8;
+}
+
+static void putU32(uint8_t* out, uint32_t value) {
+    putU16(out, value);
+    putU16(out + 2, value >> 16);
+}
+
+// Sends 0x00, COBS(record + crc), 0x00. A record is far below 254 bytes,
+// so every COBS block ends at a zero byte or at the end of the record.
+static void sendFrame(uint8_t type, uint16_t time, const uint8_t* payload, uint8_t length) {
+    uint8_t record[TELEMETRY_MAX_RECORD];
+    uint8_t size = 0;
+
+    record[size++] = type;
+    putU16(record + size, time);
+    size += 2;
+    for (uint8_t i = 0; i < length; i++) {
+        record[size++] = payload[i];
+    }
+
+    uint16_t crc = TELEMETRY_CRC_INIT;
+    for (uint8_t i = 0; i < size; i++) {
+        crc = _crc_xmodem_update(crc, record[i]);
+    }
+    putU16(record + size, crc);
+    size += 2;
+
+    // Never send half a frame: it would corrupt the next one too
+    if (usartTxFree() < size + 3) {
+        frames_dropped++;
+        return;
+    }
+
+    transmitByte(0);
+    uint8_t start = 0;
+    while (1) {
+        uint8_t end = start;
+        while (end < size && record[end] != 0) end++;
+        transmitByte(end - start + 1);
+        for (uint8_t i = start; i < end; i++) {
+            transmitByte(record[i]);
+        }
+        if (end >= size) break;
+        start = end + 1;
+    }
+    transmitByte(0);
+}
+
+// Sent in both modes: the host streaming beatmap events waits for it
+void telemetryStreamStatus(uint16_t time, uint8_t flags, uint8_t next_seq, uint8_t credits,
+                           uint16_t tick, uint16_t underruns, uint16_t late, uint16_t rejected) {
+    uint8_t payload[TELEMETRY_STREAM_SIZE];
+    payload[0] = flags;
+    payload[1] = next_seq;
+    payload[2] = credits;
+    putU16(payload + 3, tick);
+    putU16(payload + 5, underruns);
+    putU16(payload + 7, late);
+    putU16(payload + 9, rejected);
+    sendFrame(TELEMETRY_STREAM, time, payload, sizeof(payload));
+}
+
+void telemetryPong(uint16_t time, uint8_t seq, uint32_t host_time, uint16_t counts, int16_t trim) {
+    uint8_t payload[TELEMETRY_PONG_SIZE];
+    payload[0] = seq;
+    putU32(payload + 1, host_time);
+    putU16(payload + 5, counts);
+    putU16(payload + 7, (uint16_t)trim);
+    sendFrame(TELEMETRY_PONG, time, payload, sizeof(payload));
+}
+
+void telemetryGameTick(uint16_t time, uint16_t tick, uint16_t period) {
+    uint8_t payload[TELEMETRY_GAME_TICK_SIZE];
+    putU16(payload, tick);
+    putU16(payload + 2, period);
+    sendFrame(TELEMETRY_GAME_TICK, time, payload, sizeof(payload));
+}
+
+uint16_t telemetryFramesDropped(void) {
+    return frames_dropped;
+}
+
+#if TELEMETRY_BINARY
+
+void telemetryTick(uint16_t time, uint8_t level, uint8_t lives, uint8_t ship,
+                   uint8_t entities, uint16_t score, uint32_t dodged) {
+    uint8_t payload[TELEMETRY_TICK_SIZE];
+    payload[0] = level;
+    payload[1] = lives;
+    payload[2] = ship;
+    payload[3] = entities;
+    putU16(payload + 4, score);
+    putU32(payload + 6, dodged);
+    sendFrame(TELEMETRY_TICK, time, payload, sizeof(payload));
+}
+
+void telemetryCollision(uint16_t time, uint8_t lives, uint8_t ship, uint8_t kind) {
+    uint8_t payload[TELEMETRY_COLLISION_SIZE] = {lives, ship, kind};
+    sendFrame(TELEMETRY_COLLISION, time, payload, sizeof(payload));
+}
+
+void telemetryLevelUp(uint16_t time, uint8_t level, uint16_t tick_period) {
+    uint8_t payload[TELEMETRY_LEVEL_UP_SIZE];
+    payload[0] = level;
+    putU16(payload + 1, tick_period);
+    sendFrame(TELEMETRY_LEVEL_UP, time, payload, sizeof(payload));
+}
+
+void telemetryGameOver(uint16_t time, uint8_t level, uint16_t score, uint32_t dodged) {
+    uint8_t payload[TELEMETRY_GAME_OVER_SIZE];
+    payload[0] = level;
+    putU16(payload + 1, score);
+    putU32(payload + 3, dodged);
+    sendFrame(TELEMETRY_GAME_OVER, time, payload, sizeof(payload));
+}
+
+#else
+
+static uint16_t last_tick_print = 0;
+
+void telemetryTick(uint16_t time, uint8_t level, uint8_t lives, uint8_t ship,
+                   uint8_t entities, uint16_t score, uint32_t dodged) {
+    // Display info every 5 seconds
+    if ((uint16_t)(time - last_tick_print) < TELEMETRY_TEXT_INTERVAL) return;
+    last_tick_print = time;
+    printString_P(PSTR("Level: "));
+    printU8(level);
+    printString_P(PSTR(", Lives: "));
+    printU8(lives);
+    printString_P(PSTR(", Score: "));
+    printU16(score);
+    printString_P(PSTR(", Blocks dodged: "));
+    printU32(dodged);
+    transmitByte('\n');
+}
+
+void telemetryCollision(uint16_t time, uint8_t lives, uint8_t ship, uint8_t kind) {
+    if (kind == TELEMETRY_HIT_POWERUP) {
+        printString_P(PSTR("Power-up! Lives remaining: "));
+    } else {
+        printString_P(PSTR("Collision! Lives remaining: "));
+    }
+    printU8(lives);
+    transmitByte('\n');
+}
+
+void telemetryLevelUp(uint16_t time, uint8_t level, uint16_t tick_period) {
+    printString_P(PSTR("Level up! Now at level "));
+    printU8(level);
+    transmitByte('\n');
+}
+
+void telemetryGameOver(uint16_t time, uint8_t level, uint16_t score, uint32_t dodged) {
+    // The final statistics are printed by the game itself in text mode
+}
+
+#endif
@@ -0,0 +1,35 @@
+/* Game telemetry: one function per event.
+
+   Built with TELEMETRY_BINARY=1 every call sends a framed binary record
+   (see telemetry_protocol.h) that tools/telemetry_decode turns into CSV or
+   JSON. Otherwise the same calls print the human-readable lines.
+ */
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include <stdint.h>
+#include "telemetry_protocol.h"
+
+#ifndef TELEMETRY_BINARY
+#define TELEMETRY_BINARY 0
+#endif
+
+#define TELEMETRY_TEXT_INTERVAL 5000  /* text mode prints the tick state every 5 s */
+
+void telemetryTick(uint16_t time, uint8_t level, uint8_t lives, uint8_t ship,
+                   uint8_t entities, uint16_t score, uint32_t dodged);
+void telemetryCollision(uint16_t time, uint8_t lives, uint8_t ship, uint8_t kind);
+void telemetryLevelUp(uint16_t time, uint8_t level, uint16_t tick_period);
+void telemetryGameOver(uint16_t time, uint8_t level, uint16_t score, uint32_t dodged);
+
+/* Always binary, also in text mode: it answers the host streaming beatmap events */
+void telemetryStreamStatus(uint16_t time, uint8_t flags, uint8_t next_seq, uint8_t credits,
+                           uint16_t tick, uint16_t underruns, uint16_t late, uint16_t rejected);
+
+/* Always binary: clock sync with tools/conductor */
+void telemetryPong(uint16_t time, uint8_t seq, uint32_t host_time, uint16_t counts, int16_t trim);
+void telemetryGameTick(uint16_t time, uint16_t tick, uint16_t period);
+
+uint16_t telemetryFramesDropped(void);  /* frames skipped because the TX buffer was full */
+
+#endif
@@ -0,0 +1,49 @@
+/* Binary telemetry wire format, shared by the firmware and the host tools.
+
+   Every frame is sent as  0x00, COBS(record + crc), 0x00.
+   The leading 0x00 closes whatever text came before it, so plain printf
+   output and frames can share the serial line; the decoder treats any chunk
+   that fails COBS/CRC as text.
+
+   record = type (1 byte), timestamp (2 bytes), payload (0..TELEMETRY_MAX_PAYLOAD)
+   crc    = CRC-16/CCITT-FALSE (poly 0x1021, init 0xFFFF) over the record
+   All multi-byte fields are little endian. The timestamp is the game's
+   millisecond counter and wraps every 65.536 s.
+ */
+#ifndef TELEMETRY_PROTOCOL_H
+#define TELEMETRY_PROTOCOL_H
+
+#define TELEMETRY_HEADER_SIZE 3
+#define TELEMETRY_CRC_SIZE 2
+#define TELEMETRY_MAX_PAYLOAD 16
+#define TELEMETRY_MAX_RECORD (TELEMETRY_HEADER_SIZE + TELEMETRY_MAX_PAYLOAD + TELEMETRY_CRC_SIZE)
+#define TELEMETRY_CRC_INIT 0xFFFF
+
+/* Record types and payload layouts (offsets into the payload) */
+#define TELEMETRY_TICK 0x01       /* sent every game tick */
+#define TELEMETRY_TICK_SIZE 10    /* level u8, lives u8, ship u8, entities u8, score u16, dodged u32 */
+
+#define TELEMETRY_COLLISION 0x02  /* the spaceship hit something */
+#define TELEMETRY_COLLISION_SIZE 3  /* lives u8 (after the hit), ship u8, kind u8 */
+#define TELEMETRY_HIT_OBSTACLE 0
+#define TELEMETRY_HIT_POWERUP 1
+
+#define TELEMETRY_LEVEL_UP 0x03
+#define TELEMETRY_LEVEL_UP_SIZE 3   /* level u8, tick period in ms u16 */
+
+#define TELEMETRY_GAME_OVER 0x04
+#define TELEMETRY_GAME_OVER_SIZE 7  /* level u8, score u16, dodged u32 */
+
+#define TELEMETRY_STREAM 0x05     /* beatmap stream status, see beatstream_protocol.h */
+#define TELEMETRY_STREAM_SIZE 11  /* flags u8, next_seq u8, credits u8, tick u16,
+                                     underruns u16, late u16, rejected u16 */
+
+#define TELEMETRY_PONG 0x06       /* answer to a clock sync PING, see clocksync_protocol.h */
+#define TELEMETRY_PONG_SIZE 9     /* seq u8, host_time u32, counts u16, trim i16; the timestamp
+                                     is the ms the PING was read in, counts the Timer1
+                                     counts into it */
+
+#define TELEMETRY_GAME_TICK 0x07  /* a game tick, timestamped with the ms it fired in */
+#define TELEMETRY_GAME_TICK_SIZE 4  /* tick u16 (from the start of the game), period_ms u16 */
+
+#endif
@@ -2,9 +2,9 @@
 /*
   Quick and dirty functions that make serial communications work.
 
-  Note that receiveByte() blocks -- it sits and waits _forever_ for
-   a byte to come in.  If you're doing anything that's more interesting,
-   you'll want to implement this with interrupts.
+  Transmit and receive are interrupt driven through two ring buffers.
+   receiveByte() still waits _forever_ for a byte to come in; the game
+   uses usartRead(), which returns immediately.
 
    initUSART requires BAUDRATE to be defined in order to calculate
      the bit-rate multiplier.  9600 is a reasonable default.
@@ -17,11 +17,70 @@
 */
 
 #include <avr/io.h>
+#include <avr/interrupt.h>
+#include <util/atomic.h>
 #include <stdio.h>
 #include <usart.h>
 #include <util/setbaud.h>
 #include <stdlib.h>
 
+#define TX_MASK (USART_TX_BUFFER_SIZE - 1)
+
+#if (USART_TX_BUFFER_SIZE & TX_MASK) != 0 || USART_TX_BUFFER_SIZE > 256
+#error "USART_TX_BUFFER_SIZE must be a power of two, at most 256"
+#endif
+
+/* Transmit ring buffer: transmitByte() writes at tx_head, the UDRE interrupt
+   reads at tx_tail. One slot stays empty to tell full from empty. */
+static volatile uint8_t tx_buffer[USART_TX_BUFFER_SIZE];
+static volatile uint8_t tx_head = 0;
+static volatile uint8_t tx_tail = 0;
+static volatile uint16_t tx_dropped = 0;
+static uint8_t tx_peak = 0;
+static uint8_t tx_policy = USART_TX_OVERFLOW_POLICY;
+
+#define RX_MASK (USART_RX_BUFFER_SIZE - 1)
+
+#if (USART_RX_BUFFER_SIZE & RX_MASK) != 0 || USART_RX_BUFFER_SIZE > 256
+#error "USART_RX_BUFFER_SIZE must be a power of two, at most 256"
+#endif
+
+/* Receive ring buffer: USART_RX_vect writes at rx_head, usartRead() reads at rx_tail */
+static volatile uint8_t rx_buffer[USART_RX_BUFFER_SIZE];
+static volatile uint8_t rx_head = 0;
+static volatile uint8_t rx_tail = 0;
+static volatile uint16_t rx_overruns = 0;
+
+ISR(USART_RX_vect) {
+    uint8_t status = UCSR0A;
+    uint8_t data = UDR0;
+    uint8_t next = (rx_head + 1) & RX_MASK;
+
+    if (status & (1 << DOR0)) {
+        rx_overruns++;  /* the hardware lost a byte before this one */
+    }
+    if (next == rx_tail) {
+        rx_overruns++;  /* buffer full: drop the new byte */
+        return;
+    }
+    rx_buffer[rx_head] = data;
+    rx_head = next;
+}
+
+ISR(USART_UDRE_vect) {
+    uint8_t tail = tx_tail;
+    if (tail == tx_head) { /* drained by hand while interrupts were off */
+        UCSR0B &= ~(1 << UDRIE0);
+        return;
+    }
+    UDR0 = tx_buffer[tail];
+    tail = (tail + 1) & TX_MASK;
+    tx_tail = tail;
+    if (tail == tx_head) {
+        UCSR0B &= ~(1 << UDRIE0);  /* nothing left: stop the interrupt */
+    }
+}
+
 void initUSART(void) {    /* requires BAUD */
     UBRR0H = UBRRH_VALUE; /* defined in setbaud.h */
     UBRR0L = UBRRL_VALUE;
@@ -31,7 +90,7 @@ void initUSART(void) {    /* requires BAUD */
     UCSR0A &= ~(1 << U2X0);
 #endif
     /* Enable USART transmitter/receiver */
-    UCSR0B = (1 << TXEN0) | (1 << RXEN0);
+    UCSR0B = (1 << TXEN0) | (1 << RXEN0) | (1 << RXCIE0);
     UCSR0C = (1 << UCSZ01) | (1 << UCSZ00); /* 8 data bits, 1 stop bit */
 
     static FILE my_stdout = FDEV_SETUP_STREAM(transmitChar, NULL, _FDEV_SETUP_RW);
@@ -39,20 +98,107 @@ void initUSART(void) {    /* requires BAUD */
 }
 
 int transmitChar(char character, FILE *stream) {
-    loop_until_bit_is_set(UCSR0A, UDRE0);
-    UDR0 = character;
+    transmitByte(character);
     return 0;
 }
 
 void transmitByte(uint8_t data) {
-    /* Wait for empty transmit buffer */
-    loop_until_bit_is_set(UCSR0A, UDRE0);
-    UDR0 = data; /* send data */
+    uint8_t next = (tx_head + 1) & TX_MASK;
+
+    if (next == tx_tail) { /* buffer full */
+        if (tx_policy == USART_DROP_NEWEST) {
+            ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+                tx_dropped++;
+            }
+            return;
+        } else if (tx_policy == USART_DROP_OLDEST) {
+            ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+                if (next == tx_tail) { /* the interrupt may have made room meanwhile */
+                    tx_tail = (tx_tail + 1) & TX_MASK;
+                    tx_dropped++;
+                }
+            }
+        } else {
+            while (next == tx_tail) {
+                if (bit_is_clear(SREG, SREG_I)) {
+                    /* Interrupts are off, so the ISR can't run: send one byte by hand */
+                    loop_until_bit_is_set(UCSR0A, UDRE0);
+                    UDR0 = tx_buffer[tx_tail];
+                    tx_tail = (tx_tail + 1) & TX_MASK;
+                }
+            }
+        }
+    }
+
+    tx_buffer[tx_head] = data;
+    tx_head = next;
+
+    uint8_t queued = (next - tx_tail) & TX_MASK;
+    if (queued > tx_peak) tx_peak = queued;
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        UCSR0B |= (1 << UDRIE0); /* (re)start the transmit interrupt */
+    }
+}
+
+uint8_t usartSetOverflowPolicy(uint8_t policy) {
+    uint8_t previous = tx_policy;
+    tx_policy = policy;
+    return previous;
+}
+
+void usartFlush(void) {
+    while (tx_head != tx_tail) {
+        if (bit_is_clear(SREG, SREG_I)) {
+            loop_until_bit_is_set(UCSR0A, UDRE0);
+            UDR0 = tx_buffer[tx_tail];
+            tx_tail = (tx_tail + 1) & TX_MASK;
+        }
+    }
+}
+
+uint16_t usartTxDropped(void) {
+    uint16_t dropped;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        dropped = tx_dropped;
+    }
+    return dropped;
+}
+
+uint8_t usartTxPeak(void) {
+    return tx_peak;
+}
+
+uint8_t usartTxFree(void) {
+    return (tx_tail - tx_head - 1) & TX_MASK;
 }
 
 uint8_t receiveByte(void) {
-    loop_until_bit_is_set(UCSR0A, RXC0); /* Wait for incoming data */
-    return UDR0;                         /* return register value */
+    int16_t data;
+    do { /* Wait for incoming data */
+        data = usartRead();
+    } while (data == USART_NO_DATA);
+    return data;
+}
+
+uint8_t usartAvailable(void) {
+    return (rx_head - rx_tail) & RX_MASK;
+}
+
+int16_t usartRead(void) {
+    uint8_t tail = rx_tail;
+    if (tail == rx_head) return USART_NO_DATA;
+    uint8_t data = rx_buffer[tail];
+    rx_tail = (tail + 1) & RX_MASK;
+    return data;
+}
+
+uint16_t usartRxOverruns(void) {
+    uint16_t overruns;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        overruns = rx_overruns;
+    }
+    return overruns;
 }
 
 /* Here are a bunch of useful printing commands */
@@ -65,6 +211,13 @@ void printString(const char myString[]) {
     }
 }
 
+void printString_P(PGM_P myString) {
+    char character;
+    while ((character = pgm_read_byte(myString++))) {
+        transmitByte(character);
+    }
+}
+
 void readString(char myString[], uint8_t maxLength) {
     char response;
     uint8_t i;
@@ -142,10 +295,3 @@ uint8_t getNumber(void) {
     } while (thisChar != '\r');   /* until type return */
     return (100 * (hundreds - '0') + 10 * (tens - '0') + ones - '0');
 }
-
-void printFloat( float f)
-{
-    printf("%d.",(int)f);
-    int dec = (f - (int)f) * 1000;
-    printf( "%3d\n",abs(dec) );
-}
\ No newline at end of file
@@ -4,14 +4,40 @@
      the bit-rate multiplier.
  */
 #include <stdio.h>
+#include <avr/pgmspace.h>
 
 #ifndef BAUD      /* if not defined in Makefile... */
 #define BAUD 9600 /* set a safe default baud rate */
 #endif
 
-#define USART_HAS_DATA bit_is_set(UCSR0A, RXC0)
+#define USART_HAS_DATA (usartAvailable() != 0)
 #define USART_READY bit_is_set(UCSR0A, UDRE0)
 
+/* Reception is interrupt driven too: USART_RX_vect stores incoming bytes in a
+   ring buffer, read without waiting through usartAvailable()/usartRead().
+   The size must be a power of two, at most 256. 64 holds the two frames a
+   beatmap stream may have in flight while a menu polls only every 50ms. */
+#ifndef USART_RX_BUFFER_SIZE
+#define USART_RX_BUFFER_SIZE 64
+#endif
+#define USART_NO_DATA -1
+
+/* Transmission is interrupt driven: transmitByte() and stdout only copy into
+   a ring buffer that USART_UDRE_vect drains in the background.
+   The size must be a power of two, at most 256. */
+#ifndef USART_TX_BUFFER_SIZE
+#define USART_TX_BUFFER_SIZE 64
+#endif
+
+/* What transmitByte() does when the ring buffer is full */
+#define USART_DROP_NEWEST 0  /* discard the byte being written */
+#define USART_DROP_OLDEST 1  /* discard the oldest queued byte to make room */
+#define USART_BLOCK 2        /* wait for room (drains by polling if interrupts are off) */
+
+#ifndef USART_TX_OVERFLOW_POLICY
+#define USART_TX_OVERFLOW_POLICY USART_BLOCK
+#endif
+
 /* Takes the defined BAUD and F_CPU,
    calculates the bit-clock multiplier,
    and configures the hardware USART                   */
@@ -19,14 +45,34 @@ void initUSART(void);
 
 int transmitChar(char character, FILE *stream);
 
-/* Blocking transmit and receive functions.
-   When you call receiveByte() your program will hang until
-   data comes through.  We'll improve on this later. */
+/* Queue a byte for transmission (see the overflow policy above).
+   receiveByte() still waits until a byte has arrived; use usartRead()
+   when you must not block. */
 void transmitByte(uint8_t data);
 uint8_t receiveByte(void);
 
+uint8_t usartAvailable(void);
+/* Number of received bytes waiting in the receive buffer */
+int16_t usartRead(void);
+/* Oldest received byte, or USART_NO_DATA when the buffer is empty */
+uint16_t usartRxOverruns(void);
+/* Bytes lost because the receive buffer (or the hardware) overflowed */
+
+uint8_t usartSetOverflowPolicy(uint8_t policy);
+/* Selects the transmit overflow policy, returns the previous one */
+void usartFlush(void);
+/* Waits until every queued byte has been handed to the hardware */
+uint16_t usartTxDropped(void);
+/* Bytes discarded by the DROP_NEWEST/DROP_OLDEST policies so far */
+uint8_t usartTxPeak(void);
+/* Highest number of bytes ever waiting in the transmit buffer */
+uint8_t usartTxFree(void);
+/* Bytes that can be queued right now without hitting the overflow policy */
+
 void printString(const char myString[]);
 /* Utility function to transmit an entire string from RAM */
+void printString_P(PGM_P myString);
+/* Same, for a string kept in flash: printString_P(PSTR("text")) */
 void readString(char myString[], uint8_t maxLength);
 /* Define a string variable, pass it to this function
    The string will contain whatever you typed over serial */
@@ -46,4 +92,3 @@ uint8_t getNumber(void);
 /* takes in up to three ascii digits,
  converts them to a byte when press enter */
 
-void printFloat( float f);
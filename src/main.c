@@ -1,6 +1,8 @@
 #include <avr/io.h>
 #include <avr/interrupt.h>
-#include <util/delay.h>
+#include <avr/sleep.h>
+#include <util/atomic.h>
+#include <avr/pgmspace.h>
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
@@ -9,14 +11,22 @@
 #include "../libraries/display/display.h"
 #include "../libraries/button/button.h"
 #include "../libraries/potentiometer/potentiometer.h"
-
-// Game configuration
-#define MAX_LEVEL 10
-#define INITIAL_LEVEL 1
-#define MAX_LIVES 4
-#define DISPLAY_WIDTH 4
-#define SPACESHIP_POSITION_COUNT 8
-#define BLOCK_SPAWN_PROBABILITY 30  // Percentage chance per level
+#include "../libraries/buzzer/buzzer.h"
+#include "../libraries/scheduler/scheduler.h"
+#include "../libraries/profiler/profiler.h"
+#include "../libraries/entities/entities.h"
+#include "../libraries/telemetry/telemetry.h"
+#include "../libraries/console/console.h"
+#include "../libraries/format/format.h"
+#include "../libraries/rng/rng.h"
+#include "../libraries/beatmap/beatmap.h"
+#include "../libraries/beatstream/beatstream.h"
+#include "../libraries/game/game.h"
+#include "../libraries/game/game_hal.h"
+#include "../libraries/replay/replay.h"
+#include "../libraries/storage/storage.h"
+#include "../libraries/clocksync/clocksync_protocol.h"
+#include "maps/one_more_time.h"
 
 // Button definitions (based on the button library using PC1, PC2, PC3)
 #define BUTTON_1 1  // Left button
@@ -29,48 +39,81 @@
 #define DISPLAY_POS_3 2
 #define DISPLAY_POS_4 3
 
-// Timing constants (in timer ticks)
-#define TIMER_PRESCALER 1024
+// Timing constants (one timer tick = 1ms)
+#define TIMER_PRESCALER 8
 #define TIMER_FREQUENCY (F_CPU / TIMER_PRESCALER)
-#define BASE_GAME_SPEED 800  // Base speed in milliseconds (reduced from 2000 for faster movement)
+#define TIMER_TICK_COUNTS (TIMER_FREQUENCY / 1000)  // Timer1 counts per 1ms tick
+#if TIMER_TICK_COUNTS != CLOCKSYNC_COUNTS_PER_MS
+#error "the clock sync host assumes CLOCKSYNC_COUNTS_PER_MS Timer1 counts per ms"
+#endif
+#define DISPLAY_COLUMN_PERIOD 2  // Multiplex one column every 2ms
 #define DISPLAY_REFRESH_RATE 50  // Display refresh every 50ms
 #define FLASH_DURATION 500  // Flash duration for collision
+#if DISPLAY_COLUMN_PERIOD * TIMER_TICK_COUNTS != DISPLAY_SLOT_COUNTS
+#error "the display's bit-planes are timed for DISPLAY_SLOT_COUNTS per column"
+#endif
+
+// Brightness levels (0-15, see display.h): the ship stands out from the blocks
+#define SHIP_LEVEL DISPLAY_LEVEL_MAX
+#define BLOCK_LEVEL 7
+#define POWERUP_LEVEL DISPLAY_LEVEL_MAX
+#define MENU_LEVEL 5  // Dim while waiting for a level to be picked
+
+// "stats" report lines (see printStatsLine)
+#define STATS_PROFILE_LINE 5  // The profiler report starts here
+#define STATS_NONE 0xFF  // No report going out
+
+// Game recordings: the current game is recorded in RAM and saved to EEPROM at game over
+#define REPLAY_BUFFER_SIZE 256  // Header and events; a longer game is recorded up to here
+#define REPLAY_EEPROM_ADDRESS 0
+#if REPLAY_EEPROM_ADDRESS + REPLAY_BUFFER_SIZE > STORAGE_SIZE
+#error "the recording does not fit the EEPROM"
+#endif
 
 // Buzzer control macro - can be disabled for testing
-#define BUZZER_PIN PD3
 #define BUZZER_ENABLED 1
 
-// Add frequency definitions
-#define HIGH_TONE 880.00  // A5
-#define LOW_TONE 523.250  // C5
-
-// Game state structure
-typedef struct {
-    uint8_t level;
-    uint8_t lives;
-    uint8_t spaceship_position;  // 0-7 for 8-segment display positions
-    uint16_t score;
-    uint8_t game_running;
-    unsigned long blocks_dodged;  // Changed to unsigned long to match printf format
-} GameState;
-
-// Block structure for dynamic memory allocation
-typedef struct Block {
-    uint8_t position;  // 0-7 vertical position
-    uint8_t column;    // 0-3 horizontal position (display column)
-    struct Block* next;
-} Block;
-
 // Global variables
 static GameState* g_game_state = NULL;  // Pointer demonstration
-static Block* g_block_list = NULL;      // Dynamic memory allocation
 static volatile uint16_t g_timer_counter = 0;
+static volatile uint16_t g_ms_start = 0;  // Timer1 count the current millisecond began at
+static int16_t g_clock_trim = 0;          // Set by the host, see clocksync_protocol.h
+static uint8_t g_clock_trim_fraction = 0; // Carry of the 1/256 count part (ISR only)
+static uint8_t g_clock_sync = 0;          // A host syncs to us: report every game tick
+static volatile uint16_t g_game_tick_time = 0;  // Millisecond the last game tick fired in
 static volatile uint8_t g_display_refresh_flag = 0;
 static volatile uint8_t g_game_tick_flag = 0;
-static volatile uint8_t g_button_pressed = 0;
+static uint8_t g_pot_changes = 0;  // potChanges() when the main loop last woke up
+#if PROFILER_ENABLED
+static volatile uint32_t g_refresh_mark = 0;    // When the flags above were last set
+static volatile uint32_t g_game_tick_mark = 0;
+#endif
+static uint8_t g_playing = 0;  // Inside playGame()
+static uint8_t g_paused = 0;  // Game ticks stopped by the "pause" command
+static uint8_t g_stats_line = STATS_NONE;  // Next line of a "stats" report asked for while playing
+static uint8_t g_analog_steering = 0;  // The potentiometer steers the spaceship
+static uint8_t g_seed_override = 0;  // Next game uses g_next_seed (set by the "seed" command)
+static uint16_t g_next_seed = 0;
+static uint8_t g_next_block_source = BLOCKS_BEATMAP;
+static uint8_t g_stream_game = 0;  // This game took the host's stream: it is forgotten at game over
+static uint8_t g_recording[REPLAY_BUFFER_SIZE];  // This game's inputs, then the EEPROM write's source
+static ReplayWriter g_recorder;
+static uint8_t g_replaying = 0;  // The "replay" command runs the core: the hooks stay quiet
 static volatile uint8_t g_collision_flash = 0;
-static uint8_t g_display_buffer[4] = {0xFF, 0xFF, 0xFF, 0xFF};  // Global display buffer for multiplexing
-static volatile uint8_t g_current_column = 0;  // Current column being displayed
+static uint8_t g_spaceship_shown = 0;  // The last frame drew the spaceship (it blinks)
+static uint8_t g_powerups_shown = 0;   // The last frame drew the power-ups (they blink)
+
+#if PROFILER_ENABLED
+// Input-to-display latency of the last move (see noteMove)
+static volatile uint16_t g_move_time = 0;          // When its button press was accepted
+static volatile uint8_t g_move_patch_pending = 0;  // Waiting for the scan to output the patch
+static volatile uint8_t g_move_frame_pending = 0;  // 1: waiting for a frame to be drawn, 2: shown
+static volatile uint16_t g_move_frame = 0;         // Presented-frame count that will show it
+#endif
+
+// Scheduler task handles (see initTimers)
+static uint8_t g_game_tick_task = SCHEDULER_NO_TASK;
+static uint8_t g_flash_task = SCHEDULER_NO_TASK;
 
 // Function prototypes
 void initGame(void);
@@ -83,69 +126,132 @@ void playGame(void);
 void updateGame(void);
 void renderDisplay(void);
 void handleInput(void);
-void spawnBlocks(void);
-void moveBlocks(void);
-void checkCollisions(void);
-void addBlock(uint8_t position, uint8_t column);
-void removeBlock(Block* block);
-void clearAllBlocks(void);
+void moveSpaceship(uint8_t position, uint16_t press_time);
 void gameOver(void);
-void playVictoryTune(void);
+void playSound(const Note* sound);
 void updateGameStateByReference(GameState* state, uint8_t new_level);  // Pointer demonstration
-uint16_t calculateScore(uint8_t level, unsigned long blocks_dodged);
+uint16_t timerNow(void);
+void waitForWork(void);
+void waitForMenuInput(void);
+void waitMs(uint16_t ms);
+#if PROFILER_ENABLED
+void noteMove(uint16_t press_time);
+void noteMoveFrame(void);
+void measureMoveLatency(void);
+#else
+#define noteMove(press_time) do {} while (0)
+#define noteMoveFrame() do {} while (0)
+#define measureMoveLatency() do {} while (0)
+#endif
+uint8_t nextButtonPress(void);
+void printLevel(uint8_t level, PGM_P source);
+void commandHelp(uint16_t argument, uint8_t has_argument);
+void commandLevel(uint16_t argument, uint8_t has_argument);
+void commandPause(uint16_t argument, uint8_t has_argument);
+void commandResume(uint16_t argument, uint8_t has_argument);
+void commandSeed(uint16_t argument, uint8_t has_argument);
+void commandStats(uint16_t argument, uint8_t has_argument);
+void pollStats(void);
+uint8_t printStatsLine(uint8_t line);
+void commandReset(uint16_t argument, uint8_t has_argument);
+void commandPress(uint16_t argument, uint8_t has_argument);
+void commandMap(uint16_t argument, uint8_t has_argument);
+void commandRecord(uint16_t argument, uint8_t has_argument);
+void commandReplay(uint16_t argument, uint8_t has_argument);
+
+// Serial commands, polled from every wait loop (see pollConsole)
+static const ConsoleCommand g_commands[] PROGMEM = {
+    {"help", commandHelp},
+    {"level", commandLevel},    // level N: jump to level N (while playing)
+    {"pause", commandPause},
+    {"resume", commandResume},
+    {"seed", commandSeed},      // seed N: reseed the block generator (or the next game's)
+    {"stats", commandStats},    // game state, serial counters and profile
+    {"reset", commandReset},    // clear the profiler statistics
+    {"press", commandPress},    // press N: act as if button N was pressed
+    {"map", commandMap},        // map 0-2: random blocks, the beatmap or the host's stream, from the next game on
+    {"record", commandRecord},  // the last game's recording, in hex (native build: --replay)
+    {"replay", commandReplay},  // replay the last game's recording and compare the outcome
+};
+void requestDisplayRefresh(void);
+void sampleButtons(void);
+void requestGameTick(void);
+void endCollisionFlash(void);
 void displayGameInfo(void);
-void playBeep(void);
-void playLowBeep(void);
-void playTone(float frequency, uint32_t duration);
+void receiveFrame(const uint8_t* record, uint8_t length);
+void receiveClockSync(const uint8_t* record, uint8_t length);
+void sendStreamStatus(void);
+uint16_t loadRecording(void);
 
-// Timer interrupt for game timing
+// Sound effects for playSound(): {note, duration, rest after it}, in 10ms units
+static const Note SOUND_LEVEL_UP[] PROGMEM = {
+    {NOTE_E6, 6, 0}, {NOTE_A6, 10, 0}, {NOTE_END}
+};
+static const Note SOUND_COLLISION[] PROGMEM = {
+    {NOTE_E4, 4, 0}, {NOTE_C4, 8, 0}, {NOTE_END}
+};
+static const Note SOUND_POWERUP[] PROGMEM = {
+    {NOTE_C6, 4, 0}, {NOTE_E6, 4, 0}, {NOTE_G6, 6, 0}, {NOTE_END}
+};
+static const Note SOUND_GAME_OVER[] PROGMEM = {
+    {NOTE_G5, 15, 5}, {NOTE_E5, 15, 5}, {NOTE_C5, 15, 5}, {NOTE_G4, 40, 0}, {NOTE_END}
+};
+
+// Timer interrupt for game timing (every 1ms)
+// All periodic work lives in scheduler tasks whose reload values are computed
+// when they are armed, so this only advances the compare point and counts down.
 ISR(TIMER1_COMPA_vect) {
+    PROFILE_BEGIN(PROF_TIMER_ISR);
+    // Timer1 free-runs; schedule the next 1ms compare, trimmed by the host to its clock
+    uint16_t step = TIMER_TICK_COUNTS + (g_clock_trim >> 8);
+    uint8_t fraction = g_clock_trim_fraction;
+    g_clock_trim_fraction += (uint8_t)g_clock_trim;
+    if (g_clock_trim_fraction < fraction) step++;
+    g_ms_start = OCR1A;
+    OCR1A += step;
     g_timer_counter++;
-    
-    // High-frequency display multiplexing (every ~2ms for smooth display)
-    if (g_timer_counter % 2 == 0) {
-        // Display current column
-        writeRawToSegment(g_current_column, g_display_buffer[g_current_column]);
-        
-        // Move to next column
-        g_current_column = (g_current_column + 1) % 4;
-    }
-    
-    // Display refresh (every ~50ms) - now just updates the buffer content
-    if (g_timer_counter % (TIMER_FREQUENCY * DISPLAY_REFRESH_RATE / 1000) == 0) {
-        g_display_refresh_flag = 1;
-    }
-    
-    // Game tick (speed depends on level)
-    uint16_t game_speed = BASE_GAME_SPEED - (g_game_state->level * 60);  // Reduced from 150 for more gradual speed increase
-    if (game_speed < 150) game_speed = 150;  // Reduced minimum speed from 300 to 150ms for faster gameplay
-    
-    if (g_timer_counter % (TIMER_FREQUENCY * game_speed / 1000) == 0) {
-        g_game_tick_flag = 1;
-    }
+    schedulerTick();
+    measureMoveLatency();
+    PROFILE_END(PROF_TIMER_ISR);
 }
 
-// Button interrupt handler
-ISR(PCINT1_vect) {
-    static uint8_t last_button_state = 0xFF;
-    uint8_t current_state = PINC & 0x0F;  // Read PC0, PC1, PC2, PC3
-    
-    // Detect button press (falling edge)
-    if ((last_button_state & ~current_state) != 0) {
-        g_button_pressed = 1;
-    }
-    
-    last_button_state = current_state;
+#if DISPLAY_BCM_BITS > 1
+// Brightness bit-planes inside a display column's slot (armed by displayScanNext)
+ISR(TIMER1_COMPB_vect) {
+    PROFILE_BEGIN(PROF_DISPLAY_PLANE);
+    displayPlaneNext();
+    PROFILE_END(PROF_DISPLAY_PLANE);
+}
+#endif
+
+// Scheduler callbacks - these run inside the timer interrupt
+void requestDisplayRefresh(void) {
+    PROFILE_MARK(g_refresh_mark);
+    g_display_refresh_flag = 1;
+}
+
+void requestGameTick(void) {
+    PROFILE_MARK(g_game_tick_mark);
+    g_game_tick_time = g_timer_counter;
+    g_game_tick_flag = 1;
+}
+
+void endCollisionFlash(void) {
+    g_collision_flash = 0;
+}
+
+void sampleButtons(void) {
+    PROFILE_BEGIN(PROF_BUTTON_SAMPLE);
+    buttonSample(g_timer_counter);  // Interrupts are off here: no atomic read needed
+    PROFILE_END(PROF_BUTTON_SAMPLE);
 }
 
 int main(void) {
     // Initialize all systems
     initUSART();
     
-    // Enable buttons (using the button library functions)
-    enableButton(BUTTON_1);
-    enableButton(BUTTON_2);
-    enableButton(BUTTON_3);
+    // Enable buttons (debounced by the timer interrupt, see sampleButtons)
+    initButtons();
     
     initADC();  // Initialize potentiometer ADC
     initDisplay();
@@ -154,9 +260,12 @@ int main(void) {
     initBuzzer();
     initTimers();
     initInterrupts();
+    initProfiler();
+    initConsole(g_commands, sizeof(g_commands) / sizeof(g_commands[0]));
+    consoleOnFrame(receiveFrame);  // Beatmap streams and clock sync from the host
     
-    printf("=== AUDIOSURF ARDUINO ===\n");
-    printf("Welcome to Audiosurf!\n\n");
+    printString_P(PSTR("=== AUDIOSURF ARDUINO ===\n"));
+    printString_P(PSTR("Welcome to Audiosurf!\n\n"));
     
     // Main game loop
     while (1) {
@@ -166,12 +275,11 @@ int main(void) {
         playGame();
         gameOver();
         
-        printf("\nPress any button to play again...\n");
-        while (!g_button_pressed) {
-            _delay_ms(100);
+        printString_P(PSTR("\nPress any button to play again...\n"));
+        while (!nextButtonPress()) {
+            pollConsole();
+            waitForMenuInput();
         }
-        g_button_pressed = 0;
-        _delay_ms(500);  // Debounce
     }
     
     return 0;
@@ -188,517 +296,945 @@ void initGame(void) {
     g_game_state = (GameState*)malloc(sizeof(GameState));
     
     if (g_game_state == NULL) {
-        printf("Error: Could not allocate memory for game state!\n");
+        printString_P(PSTR("Error: Could not allocate memory for game state!\n"));
         while(1);  // Halt on memory allocation failure
     }
     
-    // Initialize game state
-    g_game_state->level = INITIAL_LEVEL;
-    g_game_state->lives = MAX_LIVES;
-    g_game_state->spaceship_position = 4;  // Middle position
-    g_game_state->score = 0;
-    g_game_state->game_running = 1;
-    g_game_state->blocks_dodged = 0;
+    // Initialize game state: level 1, full lives, no blocks (their source is chosen by selectLevel())
+    gameInit(g_game_state);
     
-    // Clear any existing blocks
-    clearAllBlocks();
-    
-    // Reset flags
-    g_timer_counter = 0;
+    // Reset flags (g_timer_counter keeps running: the host's clock sync follows it)
     g_display_refresh_flag = 0;
     g_game_tick_flag = 0;
-    g_button_pressed = 0;
     g_collision_flash = 0;
     
-    printf("Game initialized. Memory allocated for game state.\n");
+    printString_P(PSTR("Game initialized. Memory allocated for game state.\n"));
 }
 
 void initTimers(void) {
-    // Configure Timer1 for game timing (CTC mode)
+    // Register the periodic work before the tick interrupt starts
+    addTask(displayScanNext, DISPLAY_COLUMN_PERIOD, DISPLAY_COLUMN_PERIOD);  // Multiplexes the framebuffer
+    addTask(requestDisplayRefresh, DISPLAY_REFRESH_RATE, DISPLAY_REFRESH_RATE);
+    g_game_tick_task = addTask(requestGameTick, 0, 0);  // Armed by playGame()
+    g_flash_task = addTask(endCollisionFlash, 0, SCHEDULER_ONE_SHOT);  // Armed on collision
+    addTask(sampleButtons, BUTTON_SAMPLE_PERIOD, BUTTON_SAMPLE_PERIOD);
+    addTask(buzzerTick, BUZZER_TICK, BUZZER_TICK);
+    addTask(displayMarqueeTick, DISPLAY_MARQUEE_PERIOD, DISPLAY_MARQUEE_PERIOD);  // Scrolls long texts
+    
+    // Configure Timer1 for game timing (free-running, compare A every 1ms)
     TCCR1A = 0;
-    TCCR1B = (1 << WGM12) | (1 << CS12) | (1 << CS10);  // CTC mode, prescaler 1024
-    OCR1A = TIMER_FREQUENCY / 1000;  // 1ms intervals
+    TCCR1B = (1 << CS11);  // Normal mode, prescaler 8 (0.5us per count)
+    TCNT1 = 0;
+    OCR1A = TIMER_TICK_COUNTS;  // First tick after 1ms
     TIMSK1 |= (1 << OCIE1A);  // Enable compare match interrupt
 }
 
 void initInterrupts(void) {
-    // Enable pin change interrupts for buttons
-    PCICR |= (1 << PCIE1);
-    PCMSK1 |= (1 << PCINT8) | (1 << PCINT9) | (1 << PCINT10) | (1 << PCINT11);  // PC0, PC1, PC2, PC3
-    
+    // Buttons need no interrupt of their own: the timer samples them
+    set_sleep_mode(SLEEP_MODE_IDLE);  // Timers, ADC and USART keep running (see waitForWork)
     sei();  // Enable global interrupts
 }
 
 void initBuzzer(void) {
     #if BUZZER_ENABLED
-    DDRD |= (1 << BUZZER_PIN);  // Set buzzer pin as output
-    PORTD |= (1 << BUZZER_PIN);  // Initialize high (buzzer off)
+    enableBuzzer();  // Timer2 makes the tones; buzzerTick (see initTimers) sequences them
     #endif
 }
 
 void showTutorial(void) {
-    printf("\033[2J\033[H"); // Clear screen and move cursor to home
-    printf("\n=== GAME TUTORIAL ===\n");
-    printf("How to play Audiosurf:\n");
-    printf("1. Use buttons to move your spaceship up/down\n");
-    printf("   - Button 1 (left): Move up\n");
-    printf("   - Button 3 (right): Move down\n");
-    printf("   - Button 2 (middle): Confirm level selection\n");
-    printf("2. Avoid the blocks coming from the right\n");
-    printf("3. Your spaceship is shown on the leftmost display\n");
-    printf("4. Blocks move from right to left each game tick\n");
-    printf("5. You have 4 lives (shown by LEDs D1-D4)\n");
-    printf("6. Game speeds up as you progress through levels\n");
-    printf("7. Score is based on blocks dodged and level reached\n\n");
+    profilerPhase(PROF_PHASE_MENU);
+    printString_P(PSTR("\033[2J\033[H")); // Clear screen and move cursor to home
+    printString_P(PSTR("\n=== GAME TUTORIAL ===\n"));
+    printString_P(PSTR("How to play Audiosurf:\n"));
+    printString_P(PSTR("1. Use buttons to move your spaceship up/down\n"));
+    printString_P(PSTR("   - Button 1 (left): Move up\n"));
+    printString_P(PSTR("   - Button 3 (right): Move down\n"));
+    printString_P(PSTR("   - Button 2 (middle): Confirm level selection\n"));
+    printString_P(PSTR("2. Avoid the blocks coming from the right\n"));
+    printString_P(PSTR("3. Your spaceship is shown on the leftmost display\n"));
+    printString_P(PSTR("4. Blocks move from right to left each game tick\n"));
+    printString_P(PSTR("5. You have 4 lives (shown by LEDs D1-D4)\n"));
+    printString_P(PSTR("6. Game speeds up as you progress through levels\n"));
+    printString_P(PSTR("7. Score is based on blocks dodged and level reached\n"));
+    printString_P(PSTR("8. Blinking cells are power-ups: catch one to win back a life\n\n"));
     
-    printf("Press any button to continue...\n");
+    printString_P(PSTR("Press any button to continue...\n"));
     
-    // Welcome text animation on 8-segment display
-    char* welcome_text = "LUIS"; // Static text to display
-    writeString(welcome_text);
+    // Welcome text, scrolled by the timer interrupt while we wait
+    displayMarquee_P(PSTR("AUDIOSURF - PRESS A BUTTON"), DISPLAY_LEVEL_MAX);
     
-    while (!g_button_pressed) {
-        _delay_ms(100);  // Small delay to prevent busy waiting
+    while (!nextButtonPress()) {
+        pollConsole();
+        waitForMenuInput();
     }
-    
-    g_button_pressed = 0;
-    _delay_ms(500);
 }
 
 void selectLevel(void) {
-    printf("\033[2J\033[H"); // Clear screen and move cursor to home
-    printf("\n=== LEVEL SELECTION ===\n");
-    printf("Use pot/buttons: level (1-%d)\n", MAX_LEVEL);
-    printf("Press middle button to confirm\n\n");
+    printString_P(PSTR("\033[2J\033[H")); // Clear screen and move cursor to home
+    printString_P(PSTR("\n=== LEVEL SELECTION ===\n"));
+    printString_P(PSTR("Use pot/buttons: level (1-"));
+    printU8(MAX_LEVEL);
+    printString_P(PSTR(")\nPress middle button to confirm\n\n"));
     
     uint8_t selected_level = INITIAL_LEVEL;
-    unsigned long seed_counter = 0;
-    uint16_t last_pot_value = readADC();  // Initialize with current potentiometer value
-    uint8_t last_pot_level = (last_pot_value * MAX_LEVEL) / 1023 + 1;
+    uint16_t seed_counter = 0;
+    uint8_t last_pot_level = potScale(MAX_LEVEL) + 1;  // Map 0-1023 to 1-MAX_LEVEL
     selected_level = last_pot_level;  // Start with potentiometer position
-    printf("Level: %d\n", selected_level);
+    printLevel(selected_level, NULL);
     
-    while (1) {
-        seed_counter++;  // For random seed generation
-        
-        // Read potentiometer for level selection - only update if significantly changed
-        uint16_t pot_value = readADC();
-        uint8_t pot_level = (pot_value * MAX_LEVEL) / 1023 + 1;  // Map 0-1023 to 1-MAX_LEVEL
+    uint8_t confirmed = 0;
+    while (!confirmed) {
+        seed_counter++;  // For random seed generation (how long the menu was open)
         
-        // Only update from potentiometer if there's a significant change (more than 50 ADC units)
-        // This prevents noise from constantly changing the selection
-        if (abs(pot_value - last_pot_value) > 50 && pot_level != selected_level) {
+        // Read potentiometer for level selection - only turning it to another level counts,
+        // so a level picked with the buttons stays until the knob moves
+        // (the ADC interrupt filters the noise; this never waits for a conversion)
+        uint8_t pot_level = potScale(MAX_LEVEL) + 1;
+        if (pot_level != last_pot_level) {
             selected_level = pot_level;
-            last_pot_value = pot_value;
             last_pot_level = pot_level;
-            printf("Level: %d (pot)\n", selected_level);
+            printLevel(selected_level, PSTR(" (pot)"));
         }
         
         // Check button presses - these take priority over potentiometer
-        if (g_button_pressed) {
-            if (buttonPushed(BUTTON_1)) {  // Left button - decrease level
+        // (holding left or right keeps stepping the level)
+        ButtonEvent event;
+        while (!confirmed && buttonGetEvent(&event)) {
+            if (event.kind != BUTTON_PRESS && event.kind != BUTTON_REPEAT) continue;
+            
+            if (event.button == BUTTON_1) {  // Left button - decrease level
                 if (selected_level > 1) {
                     selected_level--;
-                    printf("Level: %d (btn)\n", selected_level);
-                    // Update potentiometer tracking to prevent immediate override
-                    last_pot_value = pot_value;
-                    last_pot_level = selected_level;
+                    printLevel(selected_level, PSTR(" (btn)"));
                 }
-            } else if (buttonPushed(BUTTON_3)) {  // Right button - increase level
+            } else if (event.button == BUTTON_3) {  // Right button - increase level
                 if (selected_level < MAX_LEVEL) {
                     selected_level++;
-                    printf("Level: %d (btn)\n", selected_level);
-                    // Update potentiometer tracking to prevent immediate override
-                    last_pot_value = pot_value;
-                    last_pot_level = selected_level;
+                    printLevel(selected_level, PSTR(" (btn)"));
                 }
-            } else if (buttonPushed(BUTTON_2)) {  // Middle button - confirm
-                break;
+            } else if (event.button == BUTTON_2 && event.kind == BUTTON_PRESS) {  // Middle button - confirm
+                confirmed = 1;
             }
-            
-            g_button_pressed = 0;
-            _delay_ms(200);  // Debounce
-        }
-        
-        // Update display buffer to show selected level (compatible with timer interrupt multiplexing)
-        // Reset all display segments to off
-        for (uint8_t i = 0; i < 4; i++) {
-            g_display_buffer[i] = 0xFF;  // All segments off
         }
         
-        // Convert selected_level to individual digits and display using SEGMENT_MAP
-        extern const uint8_t SEGMENT_MAP[];  // Access the segment map from display library
+        // Draw the selected level into the back page (the timer interrupt multiplexes it)
+        displayBeginFrame();
         
-        // Show level number starting from the leftmost position
-        if (selected_level >= 10) {
-            g_display_buffer[0] = SEGMENT_MAP[selected_level / 10];    // Tens digit
-            g_display_buffer[1] = SEGMENT_MAP[selected_level % 10];    // Units digit
-        } else {
-            g_display_buffer[0] = SEGMENT_MAP[selected_level];         // Units digit only
-        }
+        // "L" on the left, the level number right-aligned
+        displayDrawText_P(0, PSTR("L"), MENU_LEVEL);
+        displayDrawNumber(selected_level, MENU_LEVEL);
+        displayEndFrame();
         
-        _delay_ms(50);
+        pollConsole();
+        waitForMenuInput();  // A button, the knob, a command or the 50ms heartbeat
     }
     
-    // Use seed counter for random generation
-    srand(seed_counter);
+    // Seed this game's block generator from the ADC noise, the timer phase and the
+    // time of the confirming press, and the menu loop count - unless a seed was given
+    uint16_t seed = g_next_seed;
+    if (!g_seed_override) {
+        uint32_t pool = rngMix(seed_counter, potNoise());
+        pool = rngMix(pool, TCNT1);
+        pool = rngMix(pool, timerNow());
+        seed = rngFold(pool);
+    }
+    g_seed_override = 0;
+    gameSeed(g_game_state, seed);
+    
+    // Blocks follow the song's beatmap or the host's stream; the generator takes over when it ends
+    if (g_next_block_source == BLOCKS_BEATMAP && gameUseBeatmap(g_game_state, (PGM_P)BEATMAP_ONE_MORE_TIME)) {
+        printString_P(PSTR("Blocks: beatmap, "));
+    } else if (g_next_block_source == BLOCKS_STREAM && beatstreamStarted()) {
+        gameUseStream(g_game_state);
+        g_stream_game = 1;
+        printString_P(PSTR("Blocks: host stream, "));
+    } else {
+        printString_P(g_next_block_source == BLOCKS_STREAM ? PSTR("Blocks: random (no stream)\n")
+                                                           : PSTR("Blocks: random\n"));
+    }
+    if (g_game_state->block_source != BLOCKS_RANDOM) {
+        printU16(gameTickPeriod(g_game_state));
+        printString_P(PSTR(" ms per tick\n"));
+    }
     
     // Update game state using pointer (demonstration of pass by reference)
     updateGameStateByReference(g_game_state, selected_level);
     
-    printf("Starting level %d! (Seed: %lu)\n", selected_level, seed_counter);
-    _delay_ms(1000);
+    printString_P(PSTR("Starting level "));
+    printU8(selected_level);
+    printString_P(PSTR("! (Seed: "));
+    printU16(seed);
+    printString_P(PSTR(")\n"));
+    waitMs(1000);
 }
 
 void playGame(void) {
-    printf("\n=== GAME START ===\n");
-    printf("Avoid the blocks! Good luck!\n\n");
+    profilerPhase(PROF_PHASE_PLAY);
+    printString_P(PSTR("\n=== GAME START ===\n"));
+    printString_P(PSTR("Avoid the blocks! Good luck!\n\n"));
     
     // Show initial lives
     for (uint8_t i = 0; i < g_game_state->lives; i++) {
         lightUpLed(i);
     }
     
+    // Status output must never stall a game tick: drop bytes when the TX buffer is full
+    usartSetOverflowPolicy(USART_DROP_NEWEST);
+    
+    // Record the inputs from here on (the last game's recording may still be going to EEPROM)
+    while (storageBusy()) {
+        waitForMenuInput();
+    }
+    replayBegin(&g_recorder, g_recording, sizeof(g_recording), g_game_state->seed, g_game_state->level,
+                g_game_state->block_source, g_game_state->spaceship_position);
+    
+    // Game ticks only run while playing; the period changes on level up
+    // (a beatmap keeps its own tempo until it ends)
+    uint16_t game_speed = gameTickPeriod(g_game_state);
+    restartTask(g_game_tick_task, game_speed, game_speed);
+    g_playing = 1;
+    g_paused = 0;
+    
     while (g_game_state->game_running && g_game_state->lives > 0) {
         // Handle display refresh
         if (g_display_refresh_flag) {
+            PROFILE_SINCE(PROF_WAKE_REFRESH, g_refresh_mark);
+            PROFILE_BEGIN(PROF_RENDER);
             renderDisplay();
+            PROFILE_END(PROF_RENDER);
             g_display_refresh_flag = 0;
         }
         
         // Handle game tick
         if (g_game_tick_flag) {
+            PROFILE_SINCE(PROF_WAKE_TICK, g_game_tick_mark);
             updateGame();
             g_game_tick_flag = 0;
+            if (!g_game_state->game_running) break;  // No moves after the tick that ends the game
         }
         
         // Handle input
-        if (g_button_pressed) {
-            handleInput();
-            g_button_pressed = 0;
-        }
+        handleInput();
         
-        // Handle collision flash
-        if (g_collision_flash > 0) {
-            g_collision_flash--;
-            if (g_collision_flash == 0) {
-                // Stop flashing
-            }
-        }
+        // Serial commands (bounded work per call)
+        pollConsole();
+        pollStats();
         
-        _delay_ms(1);  // Small delay to prevent busy waiting
+        waitForWork();  // Asleep until an interrupt leaves something to do
+    }
+    
+    stopTask(g_game_tick_task);
+    g_game_tick_flag = 0;
+    g_playing = 0;
+    
+    // Menus print long texts: wait for room again instead of dropping
+    usartSetOverflowPolicy(USART_BLOCK);
+    while (g_stats_line != STATS_NONE) {
+        pollStats();  // The rest of a report the game's end cut short
     }
 }
 
 void updateGame(void) {
-    moveBlocks();
-    spawnBlocks();
-    checkCollisions();
-    
-    // Level progression based on blocks dodged
-    uint8_t new_level = (g_game_state->blocks_dodged / 10) + g_game_state->level;
-    if (new_level > g_game_state->level && new_level <= MAX_LEVEL) {
-        g_game_state->level = new_level;
-        printf("Level up! Now at level %d\n", g_game_state->level);
-        playBeep();
+    PROFILE_BEGIN(PROF_GAME_TICK);
+    if (g_clock_sync) {
+        uint16_t tick_time;
+        ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+            tick_time = g_game_tick_time;
+        }
+        telemetryGameTick(tick_time, g_game_state->ticks, gameTickPeriod(g_game_state));  // The host locks these to the music
     }
+    gameTick(g_game_state);  // Moves, spawns, collides and levels up (see game.h)
     
+    PROFILE_BEGIN(PROF_GAME_INFO);
     displayGameInfo();
+    PROFILE_END(PROF_GAME_INFO);
+    PROFILE_END(PROF_GAME_TICK);
 }
 
 void renderDisplay(void) {
-    // Reset display buffer for each column
-    for (uint8_t i = 0; i < 4; i++) {
-        g_display_buffer[i] = 0xFF;  // All segments off initially
-    }
+    // Draw into the back page; all segments start off
+    displayBeginFrame();
     
     // Render spaceship on leftmost display (position 0) with flicker effect
     uint8_t show_spaceship = 0;
     
     if (g_collision_flash > 0) {
-        // During collision, flash rapidly
-        show_spaceship = (g_collision_flash % 10 < 5);
+        // During collision, flash rapidly (toggles on every refresh)
+        show_spaceship = ((g_timer_counter / DISPLAY_REFRESH_RATE) % 2) == 0;
     } else {
         // Normal flicker - spaceship blinks every ~150ms for visibility
-        show_spaceship = ((g_timer_counter / 25) % 2) == 0; 
+        show_spaceship = ((g_timer_counter / 150) % 2) == 0; 
     }
     
+    g_spaceship_shown = show_spaceship;
     if (show_spaceship) {
         // Show spaceship
         // Map spaceship position (0-7) to a simple pattern
         uint8_t spaceship_pattern = 0x01 << g_game_state->spaceship_position;
-        g_display_buffer[DISPLAY_POS_1] &= ~spaceship_pattern;  // Combine with existing pattern
+        displayDrawSegmentsLevel(DISPLAY_POS_1, spaceship_pattern, SHIP_LEVEL);
     }
     
-    // Render blocks - combine all blocks for each column
-    Block* current = g_block_list;
-    while (current != NULL) {
-        if (current->column < DISPLAY_WIDTH) {
-            // Combine block pattern with existing pattern for this column
-            uint8_t block_pattern = 0x01 << current->position;
-            g_display_buffer[current->column] &= ~block_pattern;  // Combine patterns (AND operation for common cathode)
-        }
-        current = current->next;
+    // Render obstacles - each bitboard byte already is the segment mask of its column
+    for (uint8_t column = 0; column < DISPLAY_WIDTH; column++) {
+        displayDrawSegmentsLevel(column, g_game_state->obstacles.column[column], BLOCK_LEVEL);
     }
     
-    // No need to write to display here - the timer interrupt handles multiplexing automatically
-}
-
-void handleInput(void) {
-    if (buttonPushed(BUTTON_1)) {  // Left button - move up
-        if (g_game_state->spaceship_position > 0) {
-            g_game_state->spaceship_position--;
-        }
-    } else if (buttonPushed(BUTTON_3)) {  // Right button - move down
-        if (g_game_state->spaceship_position < SPACESHIP_POSITION_COUNT - 1) {
-            g_game_state->spaceship_position++;
+    // Power-ups blink so they can be told apart from obstacles
+    g_powerups_shown = ((g_timer_counter / 100) % 2) == 0;
+    if (g_powerups_shown) {
+        for (uint8_t column = 0; column < DISPLAY_WIDTH; column++) {
+            displayDrawSegmentsLevel(column, g_game_state->powerups.column[column], POWERUP_LEVEL);
         }
     }
     
-    _delay_ms(100);  // Debounce
+    // Publish the frame - the timer interrupt flips to it at the next column 0
+    noteMoveFrame();
+    displayEndFrame();
 }
 
-void spawnBlocks(void) {
-    // Spawn probability increases with level
-    uint8_t spawn_chance = BLOCK_SPAWN_PROBABILITY + (g_game_state->level * 5);
-    if (spawn_chance > 80) spawn_chance = 80;  // Cap at 80%
-    
-    // Potentially spawn multiple blocks
-    uint8_t max_spawns = (g_game_state->level / 3) + 1;
-    
-    for (uint8_t i = 0; i < max_spawns; i++) {
-        if ((rand() % 100) < spawn_chance) {
-            uint8_t position = rand() % SPACESHIP_POSITION_COUNT;
-            addBlock(position, DISPLAY_WIDTH - 1);  // Spawn at rightmost column
+void handleInput(void) {
+    // A press moves one step; holding the button keeps moving at the repeat rate
+    ButtonEvent event;
+    while (buttonGetEvent(&event)) {
+        if (event.button == BUTTON_2 && event.kind == BUTTON_HOLD) {  // Hold middle - switch steering
+            g_analog_steering = !g_analog_steering;
+            printString_P(g_analog_steering ? PSTR("Steering: potentiometer\n") : PSTR("Steering: buttons\n"));
+            continue;
         }
-    }
-}
-
-void moveBlocks(void) {
-    Block* current = g_block_list;
-    Block* prev = NULL;
-    
-    while (current != NULL) {
-        current->column--;
+        if (g_analog_steering) continue;  // The knob decides, buttons would fight it
+        if (event.kind != BUTTON_PRESS && event.kind != BUTTON_REPEAT) continue;
         
-        // Remove blocks that have moved off screen
-        if (current->column == 255) {  // Underflow indicates off-screen
-            g_game_state->blocks_dodged++;
-            g_game_state->score += 10 * g_game_state->level;
-            
-            if (prev == NULL) {
-                g_block_list = current->next;
-            } else {
-                prev->next = current->next;
+        uint8_t position = g_game_state->spaceship_position;
+        if (event.button == BUTTON_1) {  // Left button - move up
+            if (position > 0) {
+                moveSpaceship(position - 1, event.time);
             }
-            
-            Block* to_remove = current;
-            current = current->next;
-            free(to_remove);  // Dynamic memory deallocation
-        } else {
-            prev = current;
-            current = current->next;
-        }
-    }
-}
-
-void checkCollisions(void) {
-    Block* current = g_block_list;
-    
-    while (current != NULL) {
-        // Check collision with spaceship (column 0)
-        if (current->column == 0 && current->position == g_game_state->spaceship_position) {
-            // Collision detected!
-            g_game_state->lives--;
-            g_collision_flash = 50;  // Flash for 50 display refreshes
-            
-            // Turn off one LED
-            lightDownLed(g_game_state->lives);
-            
-            // Play buzzer sound when losing a life
-            playLowBeep();
-            
-            printf("Collision! Lives remaining: %d\n", g_game_state->lives);
-            
-            // Remove the collided block
-            if (current == g_block_list) {
-                g_block_list = current->next;
-            } else {
-                Block* prev = g_block_list;
-                while (prev->next != current) {
-                    prev = prev->next;
-                }
-                prev->next = current->next;
+        } else if (event.button == BUTTON_3) {  // Right button - move down
+            if (position < SPACESHIP_POSITION_COUNT - 1) {
+                moveSpaceship(position + 1, event.time);
             }
-            
-            free(current);
-            break;  // Only handle one collision per tick
         }
-        current = current->next;
     }
     
-    // Check game over condition
-    if (g_game_state->lives == 0) {
-        g_game_state->game_running = 0;
+    // Analog steering: the filtered potentiometer value maps straight to a position
+    if (g_analog_steering) {
+        uint8_t position = potScale(SPACESHIP_POSITION_COUNT);
+        if (position != g_game_state->spaceship_position) {
+            moveSpaceship(position, timerNow());
+        }
     }
 }
 
-void addBlock(uint8_t position, uint8_t column) {
-    // Dynamic memory allocation for new block
-    Block* new_block = (Block*)malloc(sizeof(Block));
-    if (new_block == NULL) {
-        printf("Warning: Could not allocate memory for new block\n");
-        return;
-    }
+// Fast path for a move: the collision check and column 0 of the frame on screen
+// are updated right away instead of at the next game tick and display refresh
+void moveSpaceship(uint8_t position, uint16_t press_time) {
+    replayMove(&g_recorder, g_game_state->ticks, position);  // O(1): a byte or two in RAM
+    gameMoveShip(g_game_state, position);  // Catches a block the ship steps into between ticks
     
-    new_block->position = position;
-    new_block->column = column;
-    new_block->next = g_block_list;
-    g_block_list = new_block;
-}
-
-void clearAllBlocks(void) {
-    while (g_block_list != NULL) {
-        Block* to_remove = g_block_list;
-        g_block_list = g_block_list->next;
-        free(to_remove);  // Dynamic memory deallocation
-    }
+    // Column 0 as renderDisplay() would draw it now
+    uint8_t segments = g_game_state->obstacles.column[0];
+    if (g_spaceship_shown) segments |= 0x01 << position;
+    if (g_powerups_shown) segments |= g_game_state->powerups.column[0];
+    displayPatchColumn(DISPLAY_POS_1, segments);  // The ship's new segment comes on at SHIP_LEVEL
+    
+    noteMove(press_time);
 }
 
 void gameOver(void) {
-    printf("\n=== GAME OVER ===\n");
+    profilerPhase(PROF_PHASE_GAME_OVER);
+    printString_P(PSTR("\n=== GAME OVER ===\n"));
     
     if (g_game_state->lives == 0) {
-        printf("All spaceships destroyed!\n");
+        printString_P(PSTR("All spaceships destroyed!\n"));
         
-        printf("Press any button to continue...\n");
+        printString_P(PSTR("Press any button to continue...\n"));
         
-        // Clear any pending button press
-        g_button_pressed = 0;
+        // Ignore presses made during the game
+        buttonClearEvents();
         
         // Continuously toggle all segments on and off until button pressed
         uint8_t blink_state = 0;  // 0 = all on, 1 = all off
-        while (!g_button_pressed) {
-            // Set all displays based on blink state
-            for (uint8_t j = 0; j < 4; j++) {
-                g_display_buffer[j] = (blink_state == 0) ? 0x00 : 0xFF;  // All segments ON then OFF (common cathode)
+        uint8_t blink_wait = 0;  // Display refreshes (50ms each) until the next toggle
+        g_display_refresh_flag = 1;  // Draw the first frame now
+        while (!nextButtonPress()) {
+            if (g_display_refresh_flag && blink_wait == 0) {
+                // Set all displays based on blink state
+                displayBeginFrame();
+                for (uint8_t j = 0; j < 4; j++) {
+                    displayDrawRaw(j, (blink_state == 0) ? 0x00 : 0xFF);  // All segments ON then OFF (common cathode)
+                }
+                displayEndFrame();
+                
+                // Toggle blink state
+                blink_state = 1 - blink_state;
+                blink_wait = 10;  // Toggle again in half a second
+            }
+            if (g_display_refresh_flag) {
+                g_display_refresh_flag = 0;
+                blink_wait--;
             }
             
-            // Toggle blink state
-            blink_state = 1 - blink_state;
-            
-            // Wait for half a second
-            _delay_ms(500);
+            pollConsole();
+            waitForWork();
         }
         
-        g_button_pressed = 0;  // Clear the button press flag
-        _delay_ms(500);  // Debounce delay
-        
-        playVictoryTune();  // Actually a defeat tune
+        playSound(SOUND_GAME_OVER);  // Keeps playing while the menu comes back
     } else {
-        printf("Game ended.\n");
+        printString_P(PSTR("Game ended.\n"));
     }
     
     // Calculate final score
-    g_game_state->score = calculateScore(g_game_state->level, g_game_state->blocks_dodged);
+    gameFinish(g_game_state);
+    
+    // Save the recording; the EEPROM interrupt writes it while the menus run
+    uint16_t recorded = replayEnd(&g_recorder, g_game_state->ticks, g_game_state->score);
+    storageWrite(REPLAY_EEPROM_ADDRESS, g_recording, recorded);
+    telemetryGameOver(timerNow(), g_game_state->level, g_game_state->score, g_game_state->blocks_dodged);
     
-    printf("Final Statistics:\n");
-    printf("- Level reached: %d\n", g_game_state->level);
-    printf("- Blocks dodged: %lu\n", g_game_state->blocks_dodged);
-    printf("- Final score: %d\n", g_game_state->score);
+    // A stream plays one game: the host sees STARTED clear and sends a new START for the next
+    if (g_stream_game) {
+        beatstreamReset();
+        sendStreamStatus();
+        g_stream_game = 0;
+    }
+    
+    printString_P(PSTR("Final Statistics:\n"));
+    printString_P(PSTR("- Level reached: "));
+    printU8(g_game_state->level);
+    printString_P(PSTR("\n- Blocks dodged: "));
+    printU32(g_game_state->blocks_dodged);
+    if (g_game_state->spawns_dropped > 0) {
+        printString_P(PSTR("\n- Spawns dropped (entity pool full): "));
+        printU16(g_game_state->spawns_dropped);
+    }
+    printString_P(PSTR("\n- Final score: "));
+    printU16(g_game_state->score);
+    printString_P(PSTR("\n- Recording: "));
+    printU16(recorded);
+    printString_P(g_recorder.flags & REPLAY_TRUNCATED ? PSTR(" bytes (full, the end is missing)") : PSTR(" bytes"));
+    printString_P(PSTR("\n- Display frames: "));
+    printU16(displayFramesPresented());
+    printString_P(PSTR(" shown, "));
+    printU16(displayFramesSuperseded());
+    printString_P(PSTR(" superseded\n- Serial: "));
+    printU16(usartTxDropped());
+    printString_P(PSTR(" bytes dropped, TX buffer peak "));
+    printU8(usartTxPeak());
+    transmitByte('/');
+    printU8(USART_TX_BUFFER_SIZE - 1);
+    transmitByte('\n');
+    #if TELEMETRY_BINARY
+    printString_P(PSTR("- Telemetry frames dropped: "));
+    printU16(telemetryFramesDropped());
+    transmitByte('\n');
+    #endif
+    profilerReport();
     
-    // Display score on 7-segment display
-    writeNumber(g_game_state->score);
+    // Scroll the score on the 7-segment display until the next game draws over it
+    displayMarqueeNumber_P(PSTR("SCORE "), g_game_state->score, DISPLAY_LEVEL_MAX);
     
     // Turn off all LEDs
     lightDownAllLeds();
     
-    // Clean up dynamic memory
-    clearAllBlocks();
+    // Clean up the playfield and dynamic memory
+    gameClear(g_game_state);
     if (g_game_state != NULL) {
         free(g_game_state);
         g_game_state = NULL;
     }
 }
 
-void playVictoryTune(void) {
+// Queues a sound effect; it plays from the timer interrupt while the game goes on
+void playSound(const Note* sound) {
     #if BUZZER_ENABLED
-    // Play a simple sequence
-    for (int i = 0; i < 3; i++) {
-        PORTD &= ~(1 << BUZZER_PIN);
-        _delay_ms(2);
-        PORTD |= (1 << BUZZER_PIN);
-        _delay_ms(1);
-    }
-    _delay_ms(100);
-    for (int i = 0; i < 3; i++) {
-        PORTD &= ~(1 << BUZZER_PIN);
-        _delay_ms(1);
-        PORTD |= (1 << BUZZER_PIN);
-        _delay_ms(1);
-    }
+    playMelody(sound);  // Dropped if the queue is full: the next effect will do
     #endif
 }
 
-void playBeep(void) {
-    #if BUZZER_ENABLED
-    // Play a short beep
-    for (int i = 0; i < 5; i++) {
-        PORTD &= ~(1 << BUZZER_PIN);
-        _delay_ms(1);
-        PORTD |= (1 << BUZZER_PIN);
-        _delay_ms(1);
+// Demonstration of pass by reference using pointers
+void updateGameStateByReference(GameState* state, uint8_t new_level) {
+    if (state != NULL) {
+        state->level = new_level;
+        printString_P(PSTR("Game state updated by reference. New level: "));
+        printU8(state->level);
+        transmitByte('\n');
     }
-    #endif
 }
 
-void playLowBeep(void) {
-    #if BUZZER_ENABLED
-    // Play a longer, lower beep
-    for (int i = 0; i < 10; i++) {
-        PORTD &= ~(1 << BUZZER_PIN);
-        _delay_ms(2);
-        PORTD |= (1 << BUZZER_PIN);
-        _delay_ms(2);
+void displayGameInfo(void) {
+    // Binary telemetry sends this every tick; text mode prints it every 5 seconds
+    telemetryTick(timerNow(), g_game_state->level, g_game_state->lives,
+                  g_game_state->spaceship_position, entityCount(&g_game_state->entities),
+                  g_game_state->score, g_game_state->blocks_dodged);
+}
+
+// Game core hooks (see game_hal.h): the shield's LEDs, buzzer and timers.
+// A replay (the "replay" command) runs the core outside of a game: nothing reaches the board then.
+void halSetLed(uint8_t led, uint8_t on) {
+    if (g_replaying) return;
+    if (on) lightUpLed(led);
+    else lightDownLed(led);
+}
+
+void halPlaySound(uint8_t sound) {
+    if (g_replaying) return;
+    if (sound == GAME_SOUND_LEVEL_UP) playSound(SOUND_LEVEL_UP);
+    else if (sound == GAME_SOUND_COLLISION) playSound(SOUND_COLLISION);
+    else playSound(SOUND_POWERUP);
+}
+
+void halFlashShip(void) {
+    if (g_replaying) return;
+    g_collision_flash = 1;  // Flash until the one-shot flash task clears it
+    restartTask(g_flash_task, FLASH_DURATION, SCHEDULER_ONE_SHOT);
+}
+
+void halSetTickPeriod(uint16_t ms) {
+    if (g_replaying) return;
+    restartTask(g_game_tick_task, ms, ms);
+}
+
+void halPrint_P(const char* text) {
+    if (g_replaying) return;
+    printString_P(text);
+}
+
+void halReportCollision(uint8_t lives, uint8_t position, uint8_t kind) {
+    if (g_replaying) return;
+    telemetryCollision(timerNow(), lives, position, kind);
+}
+
+void halReportLevelUp(uint8_t level, uint16_t period) {
+    if (g_replaying) return;
+    telemetryLevelUp(timerNow(), level, period);
+}
+
+void halReportStream(void) {
+    if (g_replaying) return;
+    sendStreamStatus();
+}
+
+// g_timer_counter is 16 bits wide, so read it with the timer interrupt held off
+uint16_t timerNow(void) {
+    uint16_t now;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        now = g_timer_counter;
     }
-    #endif
+    return now;
 }
 
-// Demonstration of pass by reference using pointers
-void updateGameStateByReference(GameState* state, uint8_t new_level) {
-    if (state != NULL) {
-        state->level = new_level;
-        printf("Game state updated by reference. New level: %d\n", state->level);
+// Call with interrupts off, right after finding nothing to do. sei() takes effect
+// only after the next instruction, so no interrupt can run between it and
+// sleep_cpu(): one that came in after the check wakes the CPU at once instead of
+// being slept through. Returns with interrupts off, once the interrupt has run.
+static inline void sleepUntilInterrupt(void) {
+    sleep_enable();
+    sei();
+    sleep_cpu();
+    sleep_disable();
+    cli();
+}
+
+// Anything an interrupt has left for the main loop (cheap: runs with interrupts off)
+static uint8_t workPending(void) {
+    return g_display_refresh_flag || g_game_tick_flag || buttonEventPending() || usartAvailable()
+        || potChanges() != g_pot_changes
+        || (g_stats_line != STATS_NONE && usartTxFree() == USART_TX_BUFFER_SIZE - 1);  // pollStats()
+}
+
+// Sleeps in idle mode until there is work. The 1ms timer, the ADC and the USART
+// wake the CPU; a wake-up that leaves no work goes straight back to sleep.
+void waitForWork(void) {
+    PROFILE_IDLE_BEGIN();
+    cli();
+    while (!workPending()) {
+        sleepUntilInterrupt();
     }
+    sei();
+    g_pot_changes = potChanges();  // The loop reads the knob from here on
+    PROFILE_IDLE_END();
 }
 
-uint16_t calculateScore(uint8_t level, unsigned long blocks_dodged) {
-    // Score calculation: base points for blocks dodged, bonus for level
-    return (blocks_dodged * 10) + (level * level * 50);
+// Menu loops have nothing to redraw every 50ms: the display refresh only wakes them
+void waitForMenuInput(void) {
+    waitForWork();
+    g_display_refresh_flag = 0;
 }
 
-void displayGameInfo(void) {
-    static uint32_t last_info_time = 0;
-    
-    // Display info every 5 seconds
-    if (g_timer_counter - last_info_time > 5000) {
-        printf("Level: %d, Lives: %d, Score: %d, Blocks dodged: %lu\n", 
-               g_game_state->level, g_game_state->lives, 
-               g_game_state->score, g_game_state->blocks_dodged);
-        last_info_time = g_timer_counter;
+// Sleeps for a number of milliseconds; nothing is handled meanwhile
+void waitMs(uint16_t ms) {
+    PROFILE_IDLE_BEGIN();
+    uint16_t start = timerNow();
+    cli();
+    while ((uint16_t)(g_timer_counter - start) < ms) {
+        sleepUntilInterrupt();
+    }
+    sei();
+    PROFILE_IDLE_END();
+}
+
+#if PROFILER_ENABLED
+// Input-to-display latency: a move is timed from its debounced button press to
+// the scan outputting the patched column, and to the first full frame drawn after it
+void noteMove(uint16_t press_time) {
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        g_move_time = press_time;
+        g_move_patch_pending = 1;
+        g_move_frame_pending = 1;
+    }
+}
+
+// Called by renderDisplay() before it publishes a frame
+void noteMoveFrame(void) {
+    if (g_move_frame_pending != 1) return;
+    // Nothing can flip before displayEndFrame(): the next flip shows this frame
+    g_move_frame = displayFramesPresented() + 1;
+    g_move_frame_pending = 2;
+}
+
+// Called from the timer interrupt, after the display scan step
+void measureMoveLatency(void) {
+    if (g_move_patch_pending && !displayPatchPending()) {
+        profilerLatency(PROF_LATENCY_PATCH, g_timer_counter - g_move_time);
+        g_move_patch_pending = 0;
+    }
+    if (g_move_frame_pending == 2 && displayFramesPresented() == g_move_frame) {
+        profilerLatency(PROF_LATENCY_FRAME, g_timer_counter - g_move_time);
+        g_move_frame_pending = 0;
+    }
+}
+#endif
+
+// Takes queued button events until a press; returns its button, or 0 if none is queued
+uint8_t nextButtonPress(void) {
+    ButtonEvent event;
+    while (buttonGetEvent(&event)) {
+        if (event.kind == BUTTON_PRESS) return event.button;
+    }
+    return 0;
+}
+
+// "Level: N (source)" line of the level selection menu; source may be NULL
+void printLevel(uint8_t level, PGM_P source) {
+    printString_P(PSTR("Level: "));
+    printU8(level);
+    if (source != NULL) printString_P(source);
+    transmitByte('\n');
+}
+
+// Serial command handlers - called from pollConsole()
+void commandHelp(uint16_t argument, uint8_t has_argument) {
+    printString_P(PSTR("commands: level N, pause, resume, seed N, stats, reset, press N, map 0-2, record, replay\n"));
+}
+
+void commandLevel(uint16_t argument, uint8_t has_argument) {
+    if (!g_playing || !has_argument || argument < 1 || argument > MAX_LEVEL) {
+        printString_P(PSTR("error: level 1-"));
+        printU8(MAX_LEVEL);
+        printString_P(PSTR(", only while playing\n"));
+        return;
+    }
+    g_game_state->level = argument;
+    replaySet(&g_recorder, g_game_state->ticks, REPLAY_SET_LEVEL, argument);
+    if (!g_paused && g_game_state->block_source == BLOCKS_RANDOM) {
+        uint16_t game_speed = gameTickPeriod(g_game_state);
+        restartTask(g_game_tick_task, game_speed, game_speed);
+    }
+    printString_P(PSTR("ok: level "));
+    printU8(g_game_state->level);
+    transmitByte('\n');
+}
+
+void commandPause(uint16_t argument, uint8_t has_argument) {
+    if (!g_playing) {
+        printString_P(PSTR("error: not playing\n"));
+        return;
+    }
+    stopTask(g_game_tick_task);
+    g_paused = 1;
+    printString_P(PSTR("ok: paused\n"));
+}
+
+void commandResume(uint16_t argument, uint8_t has_argument) {
+    if (!g_playing) {
+        printString_P(PSTR("error: not playing\n"));
+        return;
+    }
+    if (g_paused) {
+        uint16_t game_speed = gameTickPeriod(g_game_state);
+        restartTask(g_game_tick_task, game_speed, game_speed);
+        g_paused = 0;
     }
+    printString_P(PSTR("ok: resumed\n"));
 }
 
-// Add tone generation function
-void playTone(float frequency, uint32_t duration) {
-    // Calculate number of cycles needed for the duration
-    uint32_t cycles = (uint32_t)((float)duration * frequency / 1000.0);
+void commandSeed(uint16_t argument, uint8_t has_argument) {
+    if (!has_argument) {
+        printString_P(PSTR("error: seed N\n"));
+        return;
+    }
+    if (g_playing) {
+        // Restart this game's block sequence from the seed
+        gameSeed(g_game_state, argument);
+        replaySet(&g_recorder, g_game_state->ticks, REPLAY_SET_SEED, argument);
+    } else {
+        // Replaces the random seed of the next game
+        g_next_seed = argument;
+        g_seed_override = 1;
+    }
+    printString_P(PSTR("ok: seed "));
+    printU16(argument);
+    transmitByte('\n');
+}
+
+void commandStats(uint16_t argument, uint8_t has_argument) {
+    if (g_playing) {
+        g_stats_line = 0;  // pollStats() sends it a line at a time
+        return;
+    }
+    uint8_t policy = usartSetOverflowPolicy(USART_BLOCK);  // Longer than the TX buffer
+    for (uint8_t line = 0; printStatsLine(line); line++) {
+    }
+    usartSetOverflowPolicy(policy);
+}
+
+// While playing, the "stats" report goes out one line per call, once the TX buffer
+// has drained: a line only waits for the bytes the buffer can't hold (about 20ms at
+// 9600 baud for the longest), never for the whole report
+void pollStats(void) {
+    if (g_stats_line == STATS_NONE || usartTxFree() < USART_TX_BUFFER_SIZE - 1) return;
+    uint8_t policy = usartSetOverflowPolicy(USART_BLOCK);
+    g_stats_line = printStatsLine(g_stats_line) ? g_stats_line + 1 : STATS_NONE;
+    usartSetOverflowPolicy(policy);
+}
+
+// Prints line `line` of the "stats" report (some print nothing); 0 past the last one
+uint8_t printStatsLine(uint8_t line) {
+    switch (line) {
+    case 0:
+        if (g_game_state == NULL) break;
+        printString_P(PSTR("level "));
+        printU8(g_game_state->level);
+        printString_P(PSTR(", lives "));
+        printU8(g_game_state->lives);
+        printString_P(PSTR(", score "));
+        printU16(g_game_state->score);
+        printString_P(PSTR(", dodged "));
+        printU32(g_game_state->blocks_dodged);
+        printString_P(PSTR(", entities "));
+        printU8(entityCount(&g_game_state->entities));
+        printString_P(PSTR(", ship "));
+        printU8(g_game_state->spaceship_position);
+        printString_P(PSTR(", seed "));
+        printU16(g_game_state->seed);
+        if (g_game_state->block_source == BLOCKS_BEATMAP) {
+            printString_P(PSTR(", beatmap tick "));
+            printU16(g_game_state->beatmap.tick);
+        }
+        if (g_paused) printString_P(PSTR(", paused"));
+        transmitByte('\n');
+        break;
+    case 1:
+        printString_P(PSTR("time "));
+        printFixed(timerNow(), 3);
+        printString_P(PSTR(" s, frames "));
+        printU16(displayFramesPresented());
+        printString_P(PSTR(" shown / "));
+        printU16(displayFramesSuperseded());
+        printString_P(PSTR(" superseded\n"));
+        break;
+    case 2:
+        printString_P(PSTR("serial: tx dropped "));
+        printU16(usartTxDropped());
+        printString_P(PSTR(", tx peak "));
+        printU8(usartTxPeak());
+        printString_P(PSTR(", rx overruns "));
+        printU16(usartRxOverruns());
+        printString_P(PSTR(", bad frames "));
+        printU16(consoleFramesRejected());
+        transmitByte('\n');
+        break;
+    case 3:
+        if (beatstreamStarted()) {
+            BeatstreamStatus stream;
+            beatstreamGetStatus(&stream);
+            printString_P(PSTR("stream: tick "));
+            printU16(stream.tick);
+            printString_P(PSTR(", credits "));
+            printU8(stream.credits);
+            printString_P(PSTR(", underruns "));
+            printU16(stream.underruns);
+            printString_P(PSTR(", late "));
+            printU16(stream.late);
+            printString_P(PSTR(", rejected "));
+            printU16(stream.rejected);
+            if (stream.flags & BEATSTREAM_FINISHED) printString_P(PSTR(", finished"));
+            transmitByte('\n');
+        }
+        break;
+    case 4:
+        if (g_clock_sync) {
+            printString_P(PSTR("clock sync: trim "));
+            printFixed(g_clock_trim, 0);
+            printString_P(PSTR("/256 counts per ms\n"));
+        }
+        break;
+    default:
+        return profilerReportLine(line - STATS_PROFILE_LINE);
+    }
+    return 1;
+}
+
+void commandReset(uint16_t argument, uint8_t has_argument) {
+    profilerReset();
+    printString_P(PSTR("ok: reset\n"));
+}
+
+void commandPress(uint16_t argument, uint8_t has_argument) {
+    if (argument < BUTTON_1 || argument > BUTTON_3) {
+        printString_P(PSTR("error: press 1-3\n"));
+        return;
+    }
+    uint16_t now = timerNow();
+    buttonPushEvent(argument, BUTTON_PRESS, now);
+    buttonPushEvent(argument, BUTTON_RELEASE, now);
+}
+
+void commandMap(uint16_t argument, uint8_t has_argument) {
+    if (!has_argument || argument > BLOCKS_STREAM) {
+        printString_P(PSTR("error: map 0 (random), 1 (beatmap) or 2 (host stream)\n"));
+        return;
+    }
+    g_next_block_source = argument;
+    printString_P(PSTR("ok: map "));
+    printU8(argument);
+    printString_P(PSTR(" from the next game on\n"));
+}
+
+// Reads the recording saved in EEPROM into g_recording; returns its size, 0 if there is none
+uint16_t loadRecording(void) {
+    storageRead(REPLAY_EEPROM_ADDRESS, g_recording, REPLAY_HEADER_SIZE);
+    uint16_t size = replaySize(g_recording);
+    if (size == 0 || size > sizeof(g_recording)) return 0;
+    storageRead(REPLAY_EEPROM_ADDRESS + REPLAY_HEADER_SIZE, g_recording + REPLAY_HEADER_SIZE,
+                size - REPLAY_HEADER_SIZE);
+    return size;
+}
+
+void commandRecord(uint16_t argument, uint8_t has_argument) {
+    if (g_playing) {
+        printString_P(PSTR("error: not while playing\n"));  // g_recording is being written
+        return;
+    }
+    uint16_t size = loadRecording();
+    if (size == 0) {
+        printString_P(PSTR("error: no recording\n"));
+        return;
+    }
+    uint8_t policy = usartSetOverflowPolicy(USART_BLOCK);  // Longer than the TX buffer
+    printString_P(PSTR("recording: "));
+    printU16(size);
+    printString_P(PSTR(" bytes\n"));
+    for (uint16_t i = 0; i < size; i++) {
+        printHex8(g_recording[i]);
+        transmitByte((i % 16 == 15 || i == size - 1) ? '\n' : ' ');
+    }
+    usartSetOverflowPolicy(policy);
+}
+
+void commandReplay(uint16_t argument, uint8_t has_argument) {
+    if (g_playing) {
+        printString_P(PSTR("error: not while playing\n"));
+        return;
+    }
+    uint16_t size = loadRecording();
+    if (size == 0) {
+        printString_P(PSTR("error: no recording\n"));
+        return;
+    }
+    GameState* game = (GameState*)malloc(sizeof(GameState));
+    if (game == NULL) {
+        printString_P(PSTR("error: out of memory\n"));
+        return;
+    }
+    
+    // As fast as the core goes: the hooks drop the sounds, LEDs and telemetry meanwhile,
+    // and the profiler leaves the game phases' statistics to real games
+    g_replaying = 1;
+    profilerSuspend(1);
+    uint16_t start = timerNow();
+    uint8_t result = gameReplay(game, g_recording, size, (PGM_P)BEATMAP_ONE_MORE_TIME);
+    uint16_t elapsed = timerNow() - start;
+    profilerSuspend(0);
+    g_replaying = 0;
     
-    // Use fixed delays that are known at compile time
-    for (uint32_t i = 0; i < cycles; i++) {
-        PORTD &= ~(1 << BUZZER_PIN);  // turn the buzzer on
-        _delay_ms(1);  // Fixed 1ms delay
-        PORTD |= (1 << BUZZER_PIN);   // turn the buzzer off
-        _delay_ms(1);  // Fixed 1ms delay
+    if (result == GAME_REPLAY_INVALID) {
+        printString_P(PSTR("error: recording is damaged\n"));
+    } else if (result == GAME_REPLAY_STREAMED) {
+        printString_P(PSTR("error: recording of a streamed game\n"));
+    } else if (result == GAME_REPLAY_NO_MAP) {
+        printString_P(PSTR("error: the recording's beatmap does not open\n"));
+    } else {
+        printString_P(PSTR("replay: "));
+        printU16(game->ticks);
+        printString_P(PSTR(" ticks in "));
+        printU16(elapsed);
+        printString_P(PSTR(" ms, level "));
+        printU8(game->level);
+        printString_P(PSTR(", score "));
+        printU16(game->score);
+        printString_P(result == GAME_REPLAY_MATCH ? PSTR(": matches\n")
+                      : result == GAME_REPLAY_TRUNCATED ? PSTR(": recording ends here\n")
+                      : PSTR(": MISMATCH\n"));
+    }
+    free(game);
+}
+
+// Frames from the host: beatmap stream records (see beatstream_protocol.h)
+// and clock sync records (see clocksync_protocol.h)
+void receiveFrame(const uint8_t* record, uint8_t length) {
+    if (beatstreamReceive(record, length)) sendStreamStatus();
+    else receiveClockSync(record, length);
+}
+
+void receiveClockSync(const uint8_t* record, uint8_t length) {
+    if (length == 0) return;
+    uint8_t size = length - 1;
+    int16_t value = 0;  // TRIM and NUDGE
+    if (size == 2) value = (int16_t)(record[1] | (record[2] << 8));
+    switch (record[0]) {
+        case CLOCKSYNC_PING: {
+            if (size != CLOCKSYNC_PING_SIZE) return;
+            uint16_t now;
+            uint16_t counts;
+            ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+                now = g_timer_counter;
+                counts = TCNT1 - g_ms_start;  // May pass one ms if its compare is pending
+            }
+            uint32_t host_time = record[2] | ((uint32_t)record[3] << 8) | ((uint32_t)record[4] << 16)
+                                 | ((uint32_t)record[5] << 24);
+            g_clock_sync = 1;
+            telemetryPong(now, record[1], host_time, counts, g_clock_trim);
+            break;
+        }
+        case CLOCKSYNC_TRIM:
+            if (size != CLOCKSYNC_TRIM_SIZE) return;
+            if (value > CLOCKSYNC_TRIM_MAX) value = CLOCKSYNC_TRIM_MAX;
+            if (value < -CLOCKSYNC_TRIM_MAX) value = -CLOCKSYNC_TRIM_MAX;
+            ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+                g_clock_trim = value;
+            }
+            break;
+        case CLOCKSYNC_NUDGE:
+            if (size != CLOCKSYNC_NUDGE_SIZE || !g_playing || g_paused) return;
+            shiftTask(g_game_tick_task, value);
+            break;
     }
-} 
\ No newline at end of file
+}
+
+void sendStreamStatus(void) {
+    BeatstreamStatus stream;
+    beatstreamGetStatus(&stream);
+    telemetryStreamStatus(timerNow(), stream.flags, stream.next_seq, stream.credits,
+                          stream.tick, stream.underruns, stream.late, stream.rejected);
+}
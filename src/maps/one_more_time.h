@@ -0,0 +1,50 @@
+// Generated by tools/beatmap_pack - do not edit.
+// 287 events (12 runs) over 641 ticks of 488 ms, 491 bytes
+#ifndef BEATMAP_ONE_MORE_TIME_MAP_H
+#define BEATMAP_ONE_MORE_TIME_MAP_H
+
+static const uint8_t BEATMAP_ONE_MORE_TIME[] PROGMEM = {
+    0x42, 0x4D, 0x01, 0xE8, 0x01, 0x09, 0x04, 0x06, 0x04, 0x08, 0x05, 0x05,
+    0x03, 0x02, 0x02, 0x04, 0x06, 0x05, 0x03, 0x02, 0x02, 0x04, 0x01, 0x05,
+    0x03, 0x02, 0x02, 0x04, 0x05, 0x05, 0x03, 0x03, 0x02, 0x04, 0x00, 0x02,
+    0x40, 0x02, 0x01, 0x04, 0x03, 0x04, 0x01, 0x04, 0x06, 0x04, 0x00, 0x04,
+    0x01, 0x04, 0x03, 0x04, 0x00, 0x02, 0x47, 0x02, 0x03, 0x04, 0x00, 0x04,
+    0x02, 0x04, 0x04, 0x04, 0x06, 0x04, 0x02, 0x04, 0x01, 0x04, 0x04, 0x02,
+    0x40, 0x02, 0x03, 0x04, 0x05, 0x04, 0x01, 0x04, 0x01, 0x04, 0x00, 0x04,
+    0x03, 0x04, 0x07, 0x04, 0x06, 0x02, 0x47, 0x02, 0x07, 0x04, 0x05, 0x04,
+    0x04, 0x04, 0x03, 0x04, 0x02, 0x04, 0x03, 0x04, 0x01, 0x08, 0x04, 0x08,
+    0x07, 0x08, 0x05, 0x08, 0x07, 0x08, 0x04, 0x08, 0x01, 0x08, 0x01, 0x06,
+    0x15, 0x02, 0x06, 0x08, 0x02, 0x08, 0x05, 0x08, 0x02, 0x08, 0x07, 0x08,
+    0x06, 0x08, 0x00, 0x08, 0x01, 0x09, 0x05, 0x02, 0x02, 0x02, 0x27, 0x02,
+    0x07, 0x04, 0x01, 0x04, 0x01, 0x04, 0x0A, 0x02, 0x21, 0x02, 0x07, 0x04,
+    0x00, 0x04, 0x04, 0x04, 0x07, 0x02, 0x26, 0x02, 0x04, 0x04, 0x05, 0x04,
+    0x00, 0x04, 0x0B, 0x02, 0x22, 0x02, 0x05, 0x04, 0x01, 0x04, 0x07, 0x04,
+    0x00, 0x02, 0x24, 0x02, 0x03, 0x04, 0x02, 0x04, 0x03, 0x04, 0x0B, 0x02,
+    0x27, 0x02, 0x06, 0x04, 0x01, 0x04, 0x02, 0x04, 0x07, 0x02, 0x24, 0x02,
+    0x06, 0x04, 0x02, 0x04, 0x06, 0x04, 0x0C, 0x02, 0x26, 0x02, 0x04, 0x04,
+    0x05, 0x08, 0x06, 0x08, 0x03, 0x08, 0x02, 0x08, 0x01, 0x08, 0x02, 0x08,
+    0x02, 0x08, 0x03, 0x06, 0x14, 0x02, 0x03, 0x08, 0x00, 0x08, 0x07, 0x08,
+    0x02, 0x08, 0x04, 0x08, 0x04, 0x08, 0x00, 0x08, 0x02, 0x08, 0x64, 0x08,
+    0xA2, 0x08, 0x65, 0x08, 0x65, 0x08, 0x62, 0x08, 0x65, 0x08, 0xA3, 0x08,
+    0xA3, 0x04, 0x33, 0x04, 0x63, 0x08, 0xA4, 0x08, 0xA2, 0x08, 0xA3, 0x08,
+    0xA4, 0x08, 0xA2, 0x08, 0xA5, 0x08, 0xA4, 0x09, 0x04, 0x07, 0x02, 0x05,
+    0x03, 0x0F, 0x01, 0x02, 0x05, 0x04, 0x05, 0x04, 0x07, 0x02, 0x21, 0x02,
+    0x01, 0x04, 0x07, 0x04, 0x07, 0x04, 0x0B, 0x02, 0x24, 0x02, 0x07, 0x04,
+    0x01, 0x04, 0x02, 0x04, 0x01, 0x02, 0x24, 0x02, 0x05, 0x04, 0x07, 0x04,
+    0x02, 0x04, 0x0C, 0x02, 0x23, 0x02, 0x00, 0x04, 0x05, 0x04, 0x02, 0x04,
+    0x00, 0x02, 0x21, 0x02, 0x04, 0x04, 0x04, 0x04, 0x05, 0x04, 0x09, 0x02,
+    0x23, 0x02, 0x05, 0x04, 0x05, 0x04, 0x03, 0x04, 0x03, 0x02, 0x26, 0x03,
+    0x03, 0x02, 0x02, 0x04, 0x0C, 0x02, 0x25, 0x02, 0x07, 0x04, 0x00, 0x04,
+    0x00, 0x02, 0x47, 0x02, 0x03, 0x04, 0x05, 0x04, 0x07, 0x04, 0x05, 0x04,
+    0x05, 0x04, 0x01, 0x04, 0x03, 0x04, 0x01, 0x02, 0x40, 0x02, 0x05, 0x04,
+    0x03, 0x04, 0x07, 0x04, 0x00, 0x04, 0x07, 0x04, 0x05, 0x04, 0x01, 0x04,
+    0x01, 0x02, 0x87, 0x02, 0x03, 0x04, 0x07, 0x04, 0x02, 0x04, 0x06, 0x04,
+    0x05, 0x04, 0x01, 0x04, 0x06, 0x04, 0x07, 0x02, 0x87, 0x02, 0x01, 0x05,
+    0x02, 0x02, 0x02, 0x04, 0x00, 0x04, 0x02, 0x04, 0x07, 0x04, 0x02, 0x02,
+    0x87, 0x02, 0x05, 0x04, 0x02, 0x04, 0x02, 0x04, 0x00, 0x04, 0x00, 0x04,
+    0x01, 0x04, 0x02, 0x04, 0x06, 0x02, 0x80, 0x02, 0x03, 0x04, 0x00, 0x04,
+    0x04, 0x04, 0x03, 0x04, 0x04, 0x04, 0x03, 0x04, 0x03, 0x04, 0x25, 0x05,
+    0x03, 0x07, 0x04, 0x04, 0x22, 0x05, 0x03, 0x07, 0x04, 0x00, 0xFF
+};
+
+#endif
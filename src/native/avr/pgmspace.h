@@ -0,0 +1,30 @@
+/* <avr/pgmspace.h> for the native build: flash is ordinary memory here.
+
+   Only what the portable libraries (game, beatmap) and the maps use.
+   Reads go through memcpy so unaligned words are fine on any host.
+ */
+#ifndef NATIVE_PGMSPACE_H
+#define NATIVE_PGMSPACE_H
+
+#include <stdint.h>
+#include <string.h>
+
+#define PROGMEM
+#define PGM_P const char*
+#define PSTR(text) (text)
+
+static inline uint8_t pgm_read_byte(const void* address) {
+    return *(const uint8_t*)address;
+}
+
+static inline uint16_t pgm_read_word(const void* address) {
+    uint16_t word;
+    memcpy(&word, address, sizeof(word));
+    return word;
+}
+
+#define strlen_P strlen
+#define strncpy_P strncpy
+#define memcpy_P memcpy
+
+#endif
@@ -0,0 +1,289 @@
+// Headless game runner: the game core (libraries/game) on the host, as fast as it goes.
+//
+//   pio run -e native && .pio/build/native/program [--ticks N] [--seed S] [--level L] [--map] [--verbose]
+//                                                  [--record FILE] [--replay FILE]
+//
+// Plays games back to back for N game ticks in total (default 1000000), each with
+// the next seed from S on, at level L (default 1), with random blocks or the flash
+// beatmap (--map). A bot steers: before every tick it takes one step toward the
+// nearest position that is clear in the next two columns, like a player pressing a
+// button once per tick. Nothing waits for a clock, so this measures the core alone.
+//
+// Prints the games played, their mean score and level, ticks per second and a
+// checksum of every game's outcome: the same options give the same checksum on
+// any machine, and on the board.
+//
+// --record FILE saves the first game's recording (see libraries/replay) in hex, the
+// way the board's "record" command prints its last game. --replay FILE plays such a
+// recording, from the board or from --record, and exits with 1 unless it ends with the
+// recorded ticks and score: a regression check of the core against real games.
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <avr/pgmspace.h>
+#include "../../libraries/game/game.h"
+#include "../../libraries/game/game_hal.h"
+#include "../../libraries/telemetry/telemetry_protocol.h"
+#include "../../libraries/replay/replay.h"
+#include "../maps/one_more_time.h"
+
+#define RECORDING_SIZE 4096  // No EEPROM to fit here: the board keeps 256 bytes
+
+typedef struct {
+    unsigned long ticks;
+    uint16_t seed;
+    uint8_t level;
+    uint8_t map;
+    uint8_t verbose;
+    const char* record;
+    const char* replay;
+} Options;
+
+// What the HAL calls amount to, counted instead of shown
+typedef struct {
+    unsigned long sounds;
+    unsigned long collisions;
+    unsigned long powerups;
+    unsigned long level_ups;
+    unsigned long simulated_ms;  // Game time at the tick periods the board would use
+    uint16_t tick_period;
+} HalCounters;
+
+static Options g_options = { 1000000UL, 1, INITIAL_LEVEL, 0, 0, NULL, NULL };
+static HalCounters g_hal;
+static uint8_t g_recording[RECORDING_SIZE];
+static ReplayWriter g_recorder;
+static uint8_t g_recording_on = 0;
+
+static void usage(void) {
+    fprintf(stderr, "usage: program [--ticks N] [--seed S] [--level 1-%d] [--map] [--verbose] "
+            "[--record FILE] [--replay FILE]\n", MAX_LEVEL);
+    exit(2);
+}
+
+static void parseArgs(int argc, char** argv) {
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--ticks") == 0 && i + 1 < argc) g_options.ticks = strtoul(argv[++i], NULL, 0);
+        else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) g_options.seed = strtoul(argv[++i], NULL, 0);
+        else if (strcmp(argv[i], "--level") == 0 && i + 1 < argc) g_options.level = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--map") == 0) g_options.map = 1;
+        else if (strcmp(argv[i], "--verbose") == 0) g_options.verbose = 1;
+        else if (strcmp(argv[i], "--record") == 0 && i + 1 < argc) g_options.record = argv[++i];
+        else if (strcmp(argv[i], "--replay") == 0 && i + 1 < argc) g_options.replay = argv[++i];
+        else usage();
+    }
+    if (g_options.level < 1 || g_options.level > MAX_LEVEL) usage();
+}
+
+void halSetLed(uint8_t led, uint8_t on) {
+}
+
+void halPlaySound(uint8_t sound) {
+    g_hal.sounds++;
+}
+
+void halFlashShip(void) {
+}
+
+void halSetTickPeriod(uint16_t ms) {
+    g_hal.tick_period = ms;
+}
+
+void halPrint_P(const char* text) {
+    if (g_options.verbose) fputs(text, stdout);
+}
+
+void halReportCollision(uint8_t lives, uint8_t position, uint8_t kind) {
+    if (kind == TELEMETRY_HIT_POWERUP) g_hal.powerups++;
+    else g_hal.collisions++;
+}
+
+void halReportLevelUp(uint8_t level, uint16_t period) {
+    g_hal.level_ups++;
+}
+
+void halReportStream(void) {
+}
+
+static void moveShip(GameState* game, uint8_t position) {
+    if (g_recording_on) replayMove(&g_recorder, game->ticks, position);
+    gameMoveShip(game, position);
+}
+
+// One step toward the nearest position clear of obstacles in columns 0 and 1
+static void steer(GameState* game) {
+    uint8_t blocked = game->obstacles.column[0] | game->obstacles.column[1];
+    uint8_t position = game->spaceship_position;
+    if (!(blocked & (0x01 << position))) return;
+
+    for (uint8_t distance = 1; distance < SPACESHIP_POSITION_COUNT; distance++) {
+        if (position >= distance && !(blocked & (0x01 << (position - distance)))) {
+            moveShip(game, position - 1);
+            return;
+        }
+        if (position + distance < SPACESHIP_POSITION_COUNT && !(blocked & (0x01 << (position + distance)))) {
+            moveShip(game, position + 1);
+            return;
+        }
+    }
+}
+
+// FNV-1a over the bytes of a value
+static uint32_t checksum(uint32_t hash, uint32_t value) {
+    for (uint8_t i = 0; i < 4; i++) {
+        hash = (hash ^ ((value >> (8 * i)) & 0xFF)) * 16777619UL;
+    }
+    return hash;
+}
+
+static double nowSeconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Hex bytes, 16 to a line, after a "recording: N bytes" line, as the board prints them
+static void writeRecording(const char* path, const uint8_t* data, uint16_t size) {
+    FILE* file = fopen(path, "w");
+    if (file == NULL) {
+        perror(path);
+        exit(1);
+    }
+    fprintf(file, "recording: %u bytes\n", size);
+    for (uint16_t i = 0; i < size; i++) {
+        fprintf(file, "%02X%c", data[i], (i % 16 == 15 || i == size - 1) ? '\n' : ' ');
+    }
+    fclose(file);
+}
+
+// Takes the bytes of every line that holds nothing but hex byte pairs, so a whole
+// serial log can be given as long as the recording is the only hex dump in it
+static uint16_t readRecording(const char* path, uint8_t* data, uint16_t size) {
+    FILE* file = fopen(path, "r");
+    if (file == NULL) {
+        perror(path);
+        exit(1);
+    }
+    uint16_t length = 0;
+    char line[256];
+    while (fgets(line, sizeof(line), file) != NULL) {
+        uint8_t bytes[sizeof(line) / 2];
+        uint16_t count = 0;
+        char* at = line;
+        char* end;
+        while (1) {
+            while (*at == ' ' || *at == '\t') at++;
+            if (*at == '\n' || *at == '\r' || *at == '\0') break;
+            unsigned long value = strtoul(at, &end, 16);
+            if (end - at != 2) {
+                count = 0;
+                break;
+            }
+            bytes[count++] = value;
+            at = end;
+        }
+        for (uint16_t i = 0; i < count && length < size; i++) data[length++] = bytes[i];
+    }
+    fclose(file);
+    return length;
+}
+
+static int replay(void) {
+    uint16_t size = readRecording(g_options.replay, g_recording, sizeof(g_recording));
+    GameState* game = (GameState*)malloc(sizeof(GameState));
+    if (game == NULL) return 1;
+
+    double start = nowSeconds();
+    uint8_t result = gameReplay(game, g_recording, size, (PGM_P)BEATMAP_ONE_MORE_TIME);
+    double elapsed = nowSeconds() - start;
+    if (result == GAME_REPLAY_INVALID) {
+        fprintf(stderr, "program: %s holds no valid recording\n", g_options.replay);
+        return 1;
+    }
+    if (result == GAME_REPLAY_STREAMED) {
+        fprintf(stderr, "program: %s is a recording of a streamed game\n", g_options.replay);
+        return 1;
+    }
+    if (result == GAME_REPLAY_NO_MAP) {
+        fprintf(stderr, "program: the beatmap in flash is not valid\n");
+        return 1;
+    }
+    printf("replay of seed %u: %u ticks in %.1f us, level %u, score %u, dodged %lu: %s\n", game->seed,
+           game->ticks, elapsed * 1e6, game->level, game->score, game->blocks_dodged,
+           result == GAME_REPLAY_MATCH ? "matches"
+           : result == GAME_REPLAY_TRUNCATED ? "the recording ends here" : "MISMATCH");
+    free(game);
+    return result == GAME_REPLAY_MISMATCH;
+}
+
+int main(int argc, char** argv) {
+    parseArgs(argc, argv);
+    if (g_options.replay != NULL) return replay();
+
+    GameState* game = (GameState*)malloc(sizeof(GameState));
+    if (game == NULL) return 1;
+
+    unsigned long ticks = 0;
+    unsigned long games = 0;
+    unsigned long score_sum = 0;
+    unsigned long level_sum = 0;
+    uint32_t hash = 2166136261UL;
+    uint16_t seed = g_options.seed;
+    double start = nowSeconds();
+
+    while (ticks < g_options.ticks) {
+        gameInit(game);
+        gameSeed(game, seed++);
+        if (g_options.map && !gameUseBeatmap(game, (PGM_P)BEATMAP_ONE_MORE_TIME)) {
+            fprintf(stderr, "program: the beatmap in flash is not valid\n");
+            return 1;
+        }
+        game->level = g_options.level;
+        g_hal.tick_period = gameTickPeriod(game);
+        g_recording_on = g_options.record != NULL && games == 0;
+        if (g_recording_on) {
+            replayBegin(&g_recorder, g_recording, sizeof(g_recording), game->seed, game->level,
+                        game->block_source, game->spaceship_position);
+        }
+
+        while (game->game_running && game->lives > 0 && ticks < g_options.ticks) {
+            steer(game);
+            if (!game->game_running) break;  // A move can end the game between ticks, as on the board
+            gameTick(game);
+            g_hal.simulated_ms += g_hal.tick_period;
+            ticks++;
+        }
+        if (game->game_running && game->lives > 0) break;  // Out of ticks mid-game: not counted
+
+        gameFinish(game);
+        if (g_recording_on) {
+            writeRecording(g_options.record, g_recording, replayEnd(&g_recorder, game->ticks, game->score));
+        }
+        games++;
+        score_sum += game->score;
+        level_sum += game->level;
+        hash = checksum(hash, game->seed);
+        hash = checksum(hash, game->ticks);
+        hash = checksum(hash, game->score);
+        hash = checksum(hash, game->blocks_dodged);
+        if (g_options.verbose) {
+            printf("seed %u: level %u, score %u, dodged %lu, %u ticks, %u spawns dropped\n", game->seed,
+                   game->level, game->score, game->blocks_dodged, game->ticks, game->spawns_dropped);
+        }
+    }
+
+    double elapsed = nowSeconds() - start;
+    printf("%lu ticks in %.3f s: %.2f million ticks/s (%.0f h of play at the board's tick rates)\n", ticks,
+           elapsed, ticks / elapsed / 1e6, g_hal.simulated_ms / 3.6e6);
+    printf("%lu games", games);
+    if (games > 0) printf(", mean score %.1f, mean level %.2f", (double)score_sum / games, (double)level_sum / games);
+    printf("\n%lu lives lost, %lu power-ups, %lu level-ups, %lu sounds\n", g_hal.collisions, g_hal.powerups,
+           g_hal.level_ups, g_hal.sounds);
+    printf("checksum %08lx\n", (unsigned long)hash);
+
+    free(game);
+    return 0;
+}
@@ -1,7 +1,12 @@
 #!/bin/bash
 
 # Get the port from the first argument, or use a default
-PORT=${1:-"/dev/cu.usbmodem*"}
+if [ "$(uname)" = "Darwin" ]; then
+    PORT=${1:-"/dev/cu.usbmodem*"}
+else
+    PORT=${1:-"/dev/ttyACM*"}
+fi
+MUSIC="music/DaftPunkOneMoreTime.mp3"
 
 # Find the actual port if a wildcard was used
 ACTUAL_PORT=$(ls $PORT 2>/dev/null | head -n 1)
@@ -25,8 +30,21 @@ fi
 echo "Step 2: Waiting for Arduino to reset..."
 sleep 2  # Wait for Arduino to reset
 
+if [ "$(uname)" != "Darwin" ]; then
+    # Linux: the conductor starts the music with the game and keeps the two in sync
+    echo "Step 3: Building the host tools..."
+    make -C tools || exit 1
+
+    echo "Step 4: Starting the conductor..."
+    echo "Game is starting! The music starts with the game (type commands here)."
+    echo "Press Ctrl+C to stop"
+    tools/build/conductor --latency-ms 100 \
+        --play "ffplay -nodisp -autoexit -loglevel quiet $MUSIC" "$ACTUAL_PORT"
+    exit $?
+fi
+
 echo "Step 3: Starting music..."
-afplay "music/DaftPunkOneMoreTime.mp3" &
+afplay "$MUSIC" &
 
 echo "Step 4: Starting PlatformIO serial monitor..."
 echo "Game is starting! You should see the welcome message below."
@@ -0,0 +1,563 @@
+// Builds a beatmap from a track: spectral-flux onset detection and tempo estimation
+// on a PCM WAV file, quantized to the game tick.
+//
+//   beat_detect [--level N | --tick-ms N] [--threshold X] [--threads N] [--csv]
+//               [--name NAME] [--benchmark] <track.wav>
+//
+// By default one game tick is one beat of the detected tempo, like the hand-made maps.
+// --level N uses the tick of that level instead, --tick-ms any other. The output is a
+// C header like beatmap_pack's, or with --csv the event list it and beatmap_stream read.
+//
+// The STFT is split across threads by frame ranges. --benchmark runs it with 1, 2, 4...
+// threads and prints frames/s and the time spent in each stage instead of the map.
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "beatmap.hpp"
+#include "wav.hpp"
+
+using namespace audiosurf;
+
+namespace {
+
+// Keep in sync with gameSpeedForLevel() in src/main.c
+constexpr int BASE_GAME_SPEED = 800;
+constexpr int MIN_GAME_SPEED = 150;
+constexpr int MAX_LEVEL = 10;
+
+constexpr size_t WINDOW = 2048;        // STFT frame (46 ms at 44.1 kHz)
+constexpr double FRAMES_PER_SECOND = 100;
+constexpr float LOG_GAIN = 100.0f;     // log(1 + gain * magnitude) compression
+constexpr int PEAK_RADIUS = 3;         // an onset is the largest flux this many frames around
+constexpr int MEAN_BEFORE = 10;        // ... and above the mean of this window plus the threshold
+constexpr int MEAN_AFTER = 7;
+constexpr int MIN_ONSET_GAP = 3;       // frames between onsets
+constexpr double MIN_BPM = 60;
+constexpr double MAX_BPM = 200;
+constexpr double PREFERRED_BPM = 120;  // centre of the tempo prior (in octaves)
+constexpr double PRIOR_OCTAVES = 0.7;
+constexpr int POSITIONS = 8;
+constexpr uint32_t WALL_GAP = 8;       // ticks between walls
+constexpr uint32_t POWERUP_GAP = 32;   // ticks between power-ups
+
+struct Options {
+    std::string path;
+    std::string name = "BEATMAP";
+    int level = 0;  // 0: one tick per beat
+    int tick_ms = 0;
+    double threshold = 0.5;
+    unsigned threads = 0;
+    bool csv = false;
+    bool benchmark = false;
+};
+
+void usage() {
+    std::fprintf(stderr,
+                 "usage: beat_detect [--level N | --tick-ms N] [--threshold X] [--threads N] [--csv] "
+                 "[--name NAME] [--benchmark] <track.wav>\n");
+    std::exit(2);
+}
+
+Options parseArgs(int argc, char** argv) {
+    Options options;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--level" && i + 1 < argc) options.level = std::atoi(argv[++i]);
+        else if (arg == "--tick-ms" && i + 1 < argc) options.tick_ms = std::atoi(argv[++i]);
+        else if (arg == "--threshold" && i + 1 < argc) options.threshold = std::atof(argv[++i]);
+        else if (arg == "--threads" && i + 1 < argc) options.threads = static_cast<unsigned>(std::atoi(argv[++i]));
+        else if (arg == "--name" && i + 1 < argc) options.name = argv[++i];
+        else if (arg == "--csv") options.csv = true;
+        else if (arg == "--benchmark") options.benchmark = true;
+        else if (!arg.empty() && arg[0] != '-' && options.path.empty()) options.path = arg;
+        else usage();
+    }
+    if (options.path.empty() || options.level < 0 || options.level > MAX_LEVEL || options.tick_ms < 0 ||
+        options.tick_ms > 0xFFFF || (options.level != 0 && options.tick_ms != 0)) {
+        usage();
+    }
+    if (options.threads == 0) options.threads = std::max(1u, std::thread::hardware_concurrency());
+    return options;
+}
+
+int gameSpeedForLevel(int level) {
+    return std::max(BASE_GAME_SPEED - level * 60, MIN_GAME_SPEED);
+}
+
+using Clock = std::chrono::steady_clock;
+
+double msSince(Clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+// Magnitude spectrum of a real frame: a radix-2 FFT of half the length on the even and
+// odd samples as one complex signal, then split into the real frame's bins. The data is
+// kept as separate real and imaginary arrays so the butterflies vectorize.
+class Spectrum {
+public:
+    explicit Spectrum(size_t size) : n_(size / 2), bitrev_(n_), re_(n_), im_(n_), window_(size) {
+        const double pi = std::acos(-1.0);
+        int bits = 0;
+        while ((size_t{1} << bits) < n_) bits++;
+        for (size_t i = 0; i < n_; i++) {
+            size_t r = 0;
+            for (int b = 0; b < bits; b++) r |= ((i >> b) & 1) << (bits - 1 - b);
+            bitrev_[i] = static_cast<uint32_t>(r);
+        }
+        for (size_t half = 1; half < n_; half <<= 1) {
+            std::vector<float> wr(half), wi(half);
+            for (size_t k = 0; k < half; k++) {
+                wr[k] = static_cast<float>(std::cos(pi * k / half));
+                wi[k] = static_cast<float>(-std::sin(pi * k / half));
+            }
+            twiddle_re_.push_back(wr);
+            twiddle_im_.push_back(wi);
+        }
+        for (size_t k = 0; k <= n_; k++) {
+            split_cos_.push_back(static_cast<float>(std::cos(pi * k / n_)));
+            split_sin_.push_back(static_cast<float>(std::sin(pi * k / n_)));
+        }
+        for (size_t i = 0; i < size; i++) window_[i] = static_cast<float>(0.5 - 0.5 * std::cos(2 * pi * i / size));
+    }
+
+    size_t bins() const { return n_ + 1; }
+
+    // Windows the frame (2 * n_ samples) and writes bins() magnitudes
+    void magnitudes(const float* frame, float* out) {
+        float* __restrict re = re_.data();
+        float* __restrict im = im_.data();
+        const float* window = window_.data();
+        for (size_t k = 0; k < n_; k++) {
+            re[bitrev_[k]] = frame[2 * k] * window[2 * k];
+            im[bitrev_[k]] = frame[2 * k + 1] * window[2 * k + 1];
+        }
+
+        size_t stage = 0;
+        for (size_t half = 1; half < n_; half <<= 1, stage++) {
+            for (size_t start = 0; start < n_; start += 2 * half) {
+                butterflies(re + start, im + start, re + start + half, im + start + half,
+                            twiddle_re_[stage].data(), twiddle_im_[stage].data(), half);
+            }
+        }
+
+        // X[k] = E[k] + e^(-i pi k / n) O[k], E and O from Z[k] and conj(Z[n - k])
+        out[0] = std::fabs(re[0] + im[0]);
+        out[n_] = std::fabs(re[0] - im[0]);
+        const float* c = split_cos_.data();
+        const float* s = split_sin_.data();
+        for (size_t k = 1; k < n_; k++) {
+            size_t b = n_ - k;
+            float er = 0.5f * (re[k] + re[b]);
+            float ei = 0.5f * (im[k] - im[b]);
+            float orr = 0.5f * (im[k] + im[b]);
+            float oi = -0.5f * (re[k] - re[b]);
+            float xr = er + c[k] * orr + s[k] * oi;
+            float xi = ei + c[k] * oi - s[k] * orr;
+            out[k] = std::sqrt(xr * xr + xi * xi);
+        }
+    }
+
+private:
+    static void butterflies(float* __restrict ar, float* __restrict ai, float* __restrict br, float* __restrict bi,
+                            const float* __restrict wr, const float* __restrict wi, size_t count) {
+        for (size_t k = 0; k < count; k++) {
+            float tr = br[k] * wr[k] - bi[k] * wi[k];
+            float ti = br[k] * wi[k] + bi[k] * wr[k];
+            br[k] = ar[k] - tr;
+            bi[k] = ai[k] - ti;
+            ar[k] += tr;
+            ai[k] += ti;
+        }
+    }
+
+    size_t n_;
+    std::vector<uint32_t> bitrev_;
+    std::vector<std::vector<float>> twiddle_re_, twiddle_im_;
+    std::vector<float> split_cos_, split_sin_;
+    std::vector<float> re_, im_;
+    std::vector<float> window_;
+};
+
+// ln(1 + gain * x) for x >= 0 to about 1e-5, from the float's exponent and the atanh
+// series for its mantissa. Unlike std::log1p it vectorizes.
+void compress(float* values, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        float x = 1.0f + LOG_GAIN * values[i];
+        uint32_t bits;
+        std::memcpy(&bits, &x, sizeof(bits));
+        float exponent = static_cast<float>(static_cast<int32_t>(bits >> 23) - 127);
+        bits = (bits & 0x007FFFFF) | 0x3F800000;
+        float m;
+        std::memcpy(&m, &bits, sizeof(m));
+        float t = (m - 1.0f) / (m + 1.0f);  // ln(m) = 2 atanh(t), t < 1/3
+        float t2 = t * t;
+        float ln_m = 2.0f * t * (1.0f + t2 * (1.0f / 3 + t2 * (1.0f / 5 + t2 * (1.0f / 7))));
+        values[i] = exponent * 0.69314718f + ln_m;
+    }
+}
+
+struct Frame {
+    float flux;      // rise of log magnitude summed over bins
+    float centroid;  // where that rise is, as a fraction of the bins (0 low, 1 high)
+};
+
+// CPU time per stage, summed over the threads
+struct StageTimes {
+    double fft = 0;
+    double compress = 0;
+    double flux = 0;
+};
+
+// Spectral flux of frames [begin, end); frame i is centred on sample i * hop
+void analyseFrames(const Audio& audio, size_t hop, size_t begin, size_t end, std::vector<Frame>& frames,
+                   StageTimes& times) {
+    Spectrum spectrum(WINDOW);
+    size_t bins = spectrum.bins();
+    constexpr size_t LANES = 8;
+    std::vector<float> frame(WINDOW), previous(bins), current(bins), rise(bins), bin(bins);
+    for (size_t k = 0; k < bins; k++) bin[k] = static_cast<float>(k);
+    const size_t count = audio.samples.size();
+
+    auto logSpectrum = [&](size_t index, std::vector<float>& out) {
+        Clock::time_point start = Clock::now();
+        long first = static_cast<long>(index * hop) - static_cast<long>(WINDOW / 2);
+        for (size_t i = 0; i < WINDOW; i++) {
+            long at = first + static_cast<long>(i);
+            frame[i] = at >= 0 && static_cast<size_t>(at) < count ? audio.samples[at] : 0.0f;
+        }
+        spectrum.magnitudes(frame.data(), out.data());
+        Clock::time_point ffted = Clock::now();
+        compress(out.data(), bins);
+        times.fft += std::chrono::duration<double, std::milli>(ffted - start).count();
+        times.compress += msSince(ffted);
+    };
+
+    if (begin > 0) logSpectrum(begin - 1, previous);  // the frame before this block
+    else std::fill(previous.begin(), previous.end(), 0.0f);
+
+    for (size_t index = begin; index < end; index++) {
+        logSpectrum(index, current);
+        Clock::time_point start = Clock::now();
+        // Eight partial sums: a plain float sum only vectorizes with -ffast-math
+        for (size_t k = 0; k < bins; k++) rise[k] = std::max(current[k] - previous[k], 0.0f);
+        float flux_lanes[LANES] = {}, moment_lanes[LANES] = {};
+        size_t k = 0;
+        for (; k + LANES <= bins; k += LANES) {
+            for (size_t j = 0; j < LANES; j++) {
+                flux_lanes[j] += rise[k + j];
+                moment_lanes[j] += rise[k + j] * bin[k + j];
+            }
+        }
+        float flux = 0, moment = 0;
+        for (; k < bins; k++) {
+            flux += rise[k];
+            moment += rise[k] * bin[k];
+        }
+        for (size_t j = 0; j < LANES; j++) {
+            flux += flux_lanes[j];
+            moment += moment_lanes[j];
+        }
+        frames[index] = {flux, flux > 0 ? moment / (flux * static_cast<float>(bins - 1)) : 0.0f};
+        current.swap(previous);
+        times.flux += msSince(start);
+    }
+}
+
+std::vector<Frame> analyse(const Audio& audio, size_t hop, unsigned threads, StageTimes& times) {
+    size_t count = audio.samples.size() / hop + 1;
+    std::vector<Frame> frames(count);
+    std::vector<StageTimes> thread_times(threads);
+    std::vector<std::thread> workers;
+    for (unsigned t = 0; t < threads; t++) {
+        size_t begin = count * t / threads;
+        size_t end = count * (t + 1) / threads;
+        workers.emplace_back(analyseFrames, std::cref(audio), hop, begin, end, std::ref(frames),
+                             std::ref(thread_times[t]));
+    }
+    for (std::thread& worker : workers) worker.join();
+    for (const StageTimes& t : thread_times) {
+        times.fft += t.fft;
+        times.compress += t.compress;
+        times.flux += t.flux;
+    }
+    return frames;
+}
+
+struct Onset {
+    size_t frame;
+    float strength;  // standard deviations above the mean flux
+    float centroid;
+};
+
+std::vector<Onset> pickOnsets(const std::vector<Frame>& frames, double threshold) {
+    std::vector<Onset> onsets;
+    if (frames.empty()) return onsets;
+    double mean = 0, square = 0;
+    for (const Frame& f : frames) {
+        mean += f.flux;
+        square += static_cast<double>(f.flux) * f.flux;
+    }
+    mean /= frames.size();
+    double deviation = std::sqrt(std::max(square / frames.size() - mean * mean, 1e-12));
+
+    std::vector<float> z(frames.size());
+    for (size_t i = 0; i < frames.size(); i++) z[i] = static_cast<float>((frames[i].flux - mean) / deviation);
+
+    long count = static_cast<long>(z.size());
+    long last = -MIN_ONSET_GAP;
+    for (long i = 0; i < count; i++) {
+        bool peak = true;
+        for (long j = std::max(0L, i - PEAK_RADIUS); peak && j <= std::min(count - 1, i + PEAK_RADIUS); j++) {
+            peak = z[j] <= z[i];
+        }
+        if (!peak || i - last < MIN_ONSET_GAP) continue;
+        long from = std::max(0L, i - MEAN_BEFORE);
+        long to = std::min(count - 1, i + MEAN_AFTER);
+        double local = 0;
+        for (long j = from; j <= to; j++) local += z[j];
+        local /= static_cast<double>(to - from + 1);
+        if (z[i] < local + threshold) continue;
+        onsets.push_back({static_cast<size_t>(i), z[i], frames[i].centroid});
+        last = i;
+    }
+    return onsets;
+}
+
+struct Tempo {
+    double bpm = 0;
+    double period = 0;  // frames per beat
+    double phase = 0;   // frame of the first beat
+};
+
+// Autocorrelation of the onset envelope over the beat periods of MIN_BPM-MAX_BPM,
+// weighted towards PREFERRED_BPM so that half and double tempo lose, then the beat
+// grid phase with the most flux on it
+Tempo estimateTempo(const std::vector<Frame>& frames) {
+    std::vector<double> envelope(frames.size());
+    double mean = 0;
+    for (const Frame& f : frames) mean += f.flux;
+    mean /= std::max<size_t>(frames.size(), 1);
+    for (size_t i = 0; i < frames.size(); i++) envelope[i] = std::max(frames[i].flux - mean, 0.0);
+
+    size_t min_lag = static_cast<size_t>(60 * FRAMES_PER_SECOND / MAX_BPM);
+    size_t max_lag = static_cast<size_t>(60 * FRAMES_PER_SECOND / MIN_BPM) + 1;
+    Tempo tempo;
+    if (envelope.size() <= max_lag + 1) return tempo;
+
+    std::vector<double> acf(max_lag + 2, 0.0);
+    for (size_t lag = min_lag - 1; lag <= max_lag + 1; lag++) {
+        double sum = 0;
+        for (size_t i = lag; i < envelope.size(); i++) sum += envelope[i] * envelope[i - lag];
+        acf[lag] = sum / static_cast<double>(envelope.size() - lag);
+    }
+    double best_score = -1;
+    size_t best = min_lag;
+    for (size_t lag = min_lag; lag <= max_lag; lag++) {
+        double octaves = std::log2(60 * FRAMES_PER_SECOND / lag / PREFERRED_BPM) / PRIOR_OCTAVES;
+        double score = acf[lag] * std::exp(-0.5 * octaves * octaves);
+        if (score > best_score) {
+            best_score = score;
+            best = lag;
+        }
+    }
+    // Parabola through the peak and its neighbours for a fractional period
+    double left = acf[best - 1], centre = acf[best], right = acf[best + 1];
+    double curve = left - 2 * centre + right;
+    tempo.period = best + (curve < 0 ? 0.5 * (left - right) / curve : 0.0);
+    tempo.bpm = 60 * FRAMES_PER_SECOND / tempo.period;
+
+    double best_phase = -1;
+    for (size_t phase = 0; phase < static_cast<size_t>(std::ceil(tempo.period)); phase++) {
+        double sum = 0;
+        for (double at = phase; at < envelope.size(); at += tempo.period) sum += envelope[static_cast<size_t>(at)];
+        if (sum > best_phase) {
+            best_phase = sum;
+            tempo.phase = static_cast<double>(phase);
+        }
+    }
+    return tempo;
+}
+
+// The strongest onset of each tick becomes an event. Its position follows the pitch of
+// the onset (high at the top), ranked over the track so every position gets used; the
+// strongest onsets become walls and a weak one now and then a power-up.
+std::vector<BeatEvent> quantize(const std::vector<Onset>& onsets, double phase_ms, double tick_ms) {
+    std::vector<Onset> ticks;  // strongest onset per tick, frame replaced by the tick
+    for (const Onset& onset : onsets) {
+        double ms = onset.frame * 1000.0 / FRAMES_PER_SECOND - phase_ms;
+        if (ms < -tick_ms / 2) continue;
+        size_t tick = static_cast<size_t>(std::max(0.0, std::round(ms / tick_ms)));
+        if (!ticks.empty() && ticks.back().frame == tick) {
+            if (onset.strength > ticks.back().strength) ticks.back() = {tick, onset.strength, onset.centroid};
+        } else {
+            ticks.push_back({tick, onset.strength, onset.centroid});
+        }
+    }
+    if (ticks.empty()) return {};
+
+    std::vector<float> centroids, strengths;
+    for (const Onset& t : ticks) {
+        centroids.push_back(t.centroid);
+        strengths.push_back(t.strength);
+    }
+    std::sort(centroids.begin(), centroids.end());
+    std::sort(strengths.begin(), strengths.end());
+    float wall_strength = strengths[strengths.size() * 9 / 10];
+    float weak_strength = strengths[strengths.size() / 2];
+
+    std::vector<BeatEvent> events;
+    uint32_t last_wall = 0, last_powerup = 0;
+    for (const Onset& t : ticks) {
+        uint32_t tick = static_cast<uint32_t>(t.frame);
+        size_t rank = std::lower_bound(centroids.begin(), centroids.end(), t.centroid) - centroids.begin();
+        int position = POSITIONS - 1 - static_cast<int>(rank * POSITIONS / centroids.size());
+        uint8_t kind = BEATMAP_BLOCK;
+        if (t.strength >= wall_strength && tick >= last_wall + WALL_GAP) {
+            kind = BEATMAP_WALL;
+            position = std::min(position, BEATMAP_WALL_MAX_POSITION);
+            last_wall = tick;
+        } else if (t.strength <= weak_strength && tick >= last_powerup + POWERUP_GAP) {
+            kind = BEATMAP_POWERUP;
+            last_powerup = tick;
+        }
+        events.push_back({tick, static_cast<uint8_t>(BEATMAP_EVENT(position, kind, 0, BEATMAP_DRIFT_NONE))});
+    }
+    return events;
+}
+
+void printStages(const char* label, double ms, double audio_ms) {
+    std::fprintf(stderr, "  %-22s %9.1f ms  %7.1fx real time\n", label, ms, ms > 0 ? audio_ms / ms : 0.0);
+}
+
+int benchmark(const Options& options, const Audio& audio, size_t hop, double decode_ms) {
+    double audio_ms = audio.seconds() * 1000;
+    std::fprintf(stderr, "beat_detect: %.1f s of audio at %u Hz, window %zu, hop %zu\n", audio.seconds(),
+                 audio.rate, WINDOW, hop);
+
+    std::vector<unsigned> counts;
+    for (unsigned threads = 1; threads < options.threads; threads *= 2) counts.push_back(threads);
+    counts.push_back(options.threads);
+
+    std::vector<Frame> frames;
+    StageTimes times;
+    double stft_ms = 0;
+    double single_ms = 0;
+    for (unsigned threads : counts) {
+        StageTimes run_times;
+        Clock::time_point start = Clock::now();
+        frames = analyse(audio, hop, threads, run_times);
+        double ms = msSince(start);
+        if (threads == 1) {
+            single_ms = ms;
+            times = run_times;  // stage split without threads competing for cores
+        }
+        std::fprintf(stderr, "  %2u threads: %zu frames in %8.1f ms, %9.0f frames/s, %6.1fx real time, %4.2fx\n",
+                     threads, frames.size(), ms, frames.size() * 1000.0 / ms, audio_ms / ms, single_ms / ms);
+        stft_ms = ms;
+    }
+
+    Clock::time_point start = Clock::now();
+    std::vector<Onset> onsets = pickOnsets(frames, options.threshold);
+    double peaks_ms = msSince(start);
+    start = Clock::now();
+    Tempo tempo = estimateTempo(frames);
+    double tempo_ms = msSince(start);
+    start = Clock::now();
+    double tick_ms = options.tick_ms ? options.tick_ms
+                   : options.level ? gameSpeedForLevel(options.level)
+                   : std::round(60000.0 / std::max(tempo.bpm, 1.0));
+    std::vector<BeatEvent> events = quantize(onsets, tempo.phase * 1000 / FRAMES_PER_SECOND, tick_ms);
+    std::vector<uint8_t> map = encodeBeatmap(events, static_cast<uint16_t>(tick_ms));
+    double map_ms = msSince(start);
+
+    std::fprintf(stderr, "stages (the STFT split from the 1-thread run):\n");
+    printStages("decode wav", decode_ms, audio_ms);
+    printStages("window + fft", times.fft, audio_ms);
+    printStages("log magnitude", times.compress, audio_ms);
+    printStages("spectral flux", times.flux, audio_ms);
+    char label[32];
+    std::snprintf(label, sizeof(label), "stft, %u threads", options.threads);
+    printStages(label, stft_ms, audio_ms);
+    printStages("peak picking", peaks_ms, audio_ms);
+    printStages("tempo", tempo_ms, audio_ms);
+    printStages("quantize + encode", map_ms, audio_ms);
+    printStages("total", decode_ms + stft_ms + peaks_ms + tempo_ms + map_ms, audio_ms);
+    std::fprintf(stderr, "  %zu onsets, %.1f BPM, %zu events, %zu bytes\n", onsets.size(), tempo.bpm, events.size(),
+                 map.size());
+    return 0;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    Options options = parseArgs(argc, argv);
+
+    Audio audio;
+    Clock::time_point start = Clock::now();
+    try {
+        audio = readWav(options.path);
+    } catch (const std::exception& e) {
+        std::fprintf(stderr, "beat_detect: %s\n", e.what());
+        return 1;
+    }
+    double decode_ms = msSince(start);
+    size_t hop = static_cast<size_t>(std::lround(audio.rate / FRAMES_PER_SECOND));
+    if (audio.rate % static_cast<uint32_t>(FRAMES_PER_SECOND) != 0 || audio.samples.size() < WINDOW) {
+        std::fprintf(stderr, "beat_detect: need a sample rate that is a multiple of %.0f Hz and at least %zu samples\n",
+                     FRAMES_PER_SECOND, WINDOW);
+        return 1;
+    }
+    if (options.benchmark) return benchmark(options, audio, hop, decode_ms);
+
+    StageTimes times;
+    std::vector<Frame> frames = analyse(audio, hop, options.threads, times);
+    std::vector<Onset> onsets = pickOnsets(frames, options.threshold);
+    Tempo tempo = estimateTempo(frames);
+    if (tempo.bpm <= 0) {
+        std::fprintf(stderr, "beat_detect: track too short for a tempo\n");
+        return 1;
+    }
+
+    double beat_ms = 60000.0 / tempo.bpm;
+    int tick_ms = options.tick_ms ? options.tick_ms
+                : options.level ? gameSpeedForLevel(options.level)
+                : static_cast<int>(std::lround(beat_ms));
+    double phase_ms = tempo.phase * 1000 / FRAMES_PER_SECOND;
+    std::vector<BeatEvent> events = quantize(onsets, phase_ms, tick_ms);
+
+    size_t runs = 0;
+    std::vector<uint8_t> map = encodeBeatmap(events, static_cast<uint16_t>(tick_ms), &runs);
+    if (map.empty() || !beatmapRoundTrips(map, events)) {
+        std::fprintf(stderr, "beat_detect: events more than %d ticks apart\n", BEATMAP_MAX_DELTA);
+        return 1;
+    }
+    uint32_t ticks = events.empty() ? 0 : events.back().tick + 1;
+
+    if (options.csv) {
+        std::printf("# Generated by tools/beat_detect from %s\n", options.path.c_str());
+        std::printf("# %.1f BPM, tick 0 at %.0f ms into the track. Pack with: tools/build/beatmap_pack "
+                    "--tick-ms %d\n",
+                    tempo.bpm, phase_ms, tick_ms);
+        for (const BeatEvent& event : events) {
+            uint8_t kind = BEATMAP_KIND(event.event);
+            std::printf("%u,%u,%s\n", event.tick, BEATMAP_POSITION(event.event),
+                        kind == BEATMAP_WALL ? "wall" : kind == BEATMAP_POWERUP ? "powerup" : "block");
+        }
+    } else {
+        writeBeatmapHeader(stdout, "beat_detect", options.name, map, events.size(), runs, ticks, tick_ms);
+    }
+
+    std::fprintf(stderr,
+                 "beat_detect: %.1f BPM (a beat every %.0f ms), tick 0 at %.0f ms into the track; "
+                 "%zu onsets -> %zu events over %u ticks of %d ms, %zu bytes\n",
+                 tempo.bpm, beat_ms, phase_ms, onsets.size(), events.size(), ticks, tick_ms, map.size());
+    return 0;
+}
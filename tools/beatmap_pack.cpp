@@ -0,0 +1,80 @@
+// Packs a beatmap event list into a C header for the firmware (see libraries/beatmap).
+//
+//   beatmap_pack [--tick-ms N] [--name NAME] <events.csv | ->  > map.h
+//
+// One event per line:  tick,position,kind[,slow[,drift[,count,period]]]
+//   kind    block, wall or powerup
+//   slow    1 for half speed
+//   drift   -1 (up), 0 or 1 (down), one position per tick
+//   count   the event comes count more times, period ticks apart
+// Blank lines and lines starting with '#' are skipped.
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include "beatmap.hpp"
+
+using namespace audiosurf;
+
+namespace {
+
+struct Options {
+    std::string path;
+    std::string name = "BEATMAP";
+    int tick_ms = 500;
+};
+
+void usage() {
+    std::fprintf(stderr, "usage: beatmap_pack [--tick-ms N] [--name NAME] <events.csv|->\n");
+    std::exit(2);
+}
+
+Options parseArgs(int argc, char** argv) {
+    Options options;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--tick-ms" && i + 1 < argc) options.tick_ms = std::atoi(argv[++i]);
+        else if (arg == "--name" && i + 1 < argc) options.name = argv[++i];
+        else if (!arg.empty() && (arg[0] != '-' || arg == "-") && options.path.empty()) options.path = arg;
+        else usage();
+    }
+    if (options.path.empty() || options.tick_ms <= 0 || options.tick_ms > 0xFFFF) usage();
+    return options;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    Options options = parseArgs(argc, argv);
+
+    std::vector<BeatEvent> events;
+    std::string error;
+    if (!readBeatmapCsv(options.path, events, error)) {
+        std::fprintf(stderr, "beatmap_pack: %s\n", error.c_str());
+        return 1;
+    }
+
+    size_t runs = 0;
+    std::vector<uint8_t> map = encodeBeatmap(events, static_cast<uint16_t>(options.tick_ms), &runs);
+    if (map.empty()) {
+        std::fprintf(stderr, "beatmap_pack: events more than %d ticks apart\n", BEATMAP_MAX_DELTA);
+        return 1;
+    }
+
+    // The firmware decoder has to give back exactly what went in
+    if (!beatmapRoundTrips(map, events)) {
+        std::fprintf(stderr, "beatmap_pack: round trip failed\n");
+        return 1;
+    }
+
+    uint32_t ticks = 0;
+    for (const BeatEvent& event : events) ticks = std::max(ticks, event.tick + 1);
+    writeBeatmapHeader(stdout, "beatmap_pack", options.name, map, events.size(), runs, ticks, options.tick_ms);
+
+    std::fprintf(stderr, "beatmap_pack: %zu events, %zu runs, %zu bytes (%.2f bytes per event)\n", events.size(),
+                 runs, map.size(), events.empty() ? 0.0 : static_cast<double>(map.size()) / events.size());
+    return 0;
+}
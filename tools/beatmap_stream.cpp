@@ -0,0 +1,236 @@
+// Streams a beatmap to the board over serial, with credit-based flow control
+// (see libraries/beatstream/beatstream_protocol.h). Select it on the board with "map 2".
+//
+//   beatmap_stream [--baud N] [--tick-ms N] [--text] [--stall-every MS --stall-for MS]
+//                  <device> <events.csv>
+//
+// The events are the CSV that beatmap_pack reads. --stall-every/--stall-for make the
+// tool stop reading and sending for a while, to check that the board rides it out.
+
+#include <poll.h>
+#include <time.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include "beatmap.hpp"
+#include "beatstream_protocol.h"
+#include "cobs.hpp"
+#include "serial_port.hpp"
+#include "telemetry_protocol.h"
+
+using namespace audiosurf;
+
+namespace {
+
+struct Options {
+    std::string device;
+    std::string events;
+    int baud = 9600;
+    int tick_ms = 488;
+    bool text = false;
+    long stall_every = 0;
+    long stall_for = 0;
+};
+
+void usage() {
+    std::fprintf(stderr,
+                 "usage: beatmap_stream [--baud N] [--tick-ms N] [--text] "
+                 "[--stall-every MS --stall-for MS] <device> <events.csv>\n");
+    std::exit(2);
+}
+
+Options parseArgs(int argc, char** argv) {
+    Options options;
+    std::vector<std::string> paths;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--baud" && i + 1 < argc) options.baud = std::atoi(argv[++i]);
+        else if (arg == "--tick-ms" && i + 1 < argc) options.tick_ms = std::atoi(argv[++i]);
+        else if (arg == "--text") options.text = true;
+        else if (arg == "--stall-every" && i + 1 < argc) options.stall_every = std::atol(argv[++i]);
+        else if (arg == "--stall-for" && i + 1 < argc) options.stall_for = std::atol(argv[++i]);
+        else if (!arg.empty() && (arg[0] != '-' || arg == "-")) paths.push_back(arg);
+        else usage();
+    }
+    if (paths.size() != 2 || options.tick_ms <= 0 || options.tick_ms > 0xFFFF) usage();
+    options.device = paths[0];
+    options.events = paths[1];
+    return options;
+}
+
+long nowMs() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000L + ts.tv_nsec / 1000000L;
+}
+
+// One EVENTS record per device bank, then the END record
+std::vector<std::vector<uint8_t>> buildRecords(const std::vector<BeatEvent>& events) {
+    std::vector<std::vector<uint8_t>> records;
+    for (size_t i = 0; i < events.size(); i += BEATSTREAM_BANK_EVENTS) {
+        size_t count = std::min<size_t>(BEATSTREAM_BANK_EVENTS, events.size() - i);
+        std::vector<uint8_t> record{BEATSTREAM_EVENTS, static_cast<uint8_t>(records.size()),
+                                    static_cast<uint8_t>(count)};
+        for (size_t k = i; k < i + count; k++) {
+            record.push_back(events[k].tick & 0xFF);
+            record.push_back(events[k].tick >> 8);
+            record.push_back(events[k].event);
+        }
+        records.push_back(record);
+    }
+    records.push_back({BEATSTREAM_END, static_cast<uint8_t>(records.size())});
+    return records;
+}
+
+struct Status {
+    uint8_t flags = 0;
+    uint8_t next_seq = 0;
+    uint8_t credits = 0;
+    uint16_t tick = 0;
+    uint16_t underruns = 0;
+    uint16_t late = 0;
+    uint16_t rejected = 0;
+};
+
+bool parseStatus(const std::vector<uint8_t>& record, Status& status) {
+    if (record.size() != TELEMETRY_HEADER_SIZE + TELEMETRY_STREAM_SIZE || record[0] != TELEMETRY_STREAM) {
+        return false;
+    }
+    const uint8_t* p = record.data() + TELEMETRY_HEADER_SIZE;
+    status.flags = p[0];
+    status.next_seq = p[1];
+    status.credits = p[2];
+    status.tick = readU16(p + 3);
+    status.underruns = readU16(p + 5);
+    status.late = readU16(p + 7);
+    status.rejected = readU16(p + 9);
+    return true;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    Options options = parseArgs(argc, argv);
+
+    std::vector<BeatEvent> events;
+    std::string error;
+    if (!readBeatmapCsv(options.events, events, error)) {
+        std::fprintf(stderr, "beatmap_stream: %s\n", error.c_str());
+        return 1;
+    }
+    std::stable_sort(events.begin(), events.end(),
+                     [](const BeatEvent& a, const BeatEvent& b) { return a.tick < b.tick; });
+    if (!events.empty() && events.back().tick > 0xFFFF) {
+        std::fprintf(stderr, "beatmap_stream: ticks past 65535 can't be streamed\n");
+        return 1;
+    }
+    std::vector<std::vector<uint8_t>> records = buildRecords(events);
+
+    try {
+        SerialPort port(options.device, options.baud, true);
+        FrameReader reader;
+        Status status;
+
+        const std::vector<uint8_t> start{BEATSTREAM_START, static_cast<uint8_t>(options.tick_ms & 0xFF),
+                                         static_cast<uint8_t>(options.tick_ms >> 8)};
+        bool started = false;
+        bool finished = false;
+        size_t sent = 0;     // records sent (the next one to send)
+        size_t acked = 0;    // records the board has taken
+        long start_sent = 0;
+        long last_progress = nowMs();
+        long last_report = 0;
+        long next_stall = options.stall_every > 0 ? nowMs() + options.stall_every : 0;
+        uint64_t resends = 0;
+
+        auto send = [&](const std::vector<uint8_t>& record) {
+            std::vector<uint8_t> frame = encodeFrame(record);
+            if (!port.writeAll(frame.data(), frame.size())) throw std::runtime_error("write failed");
+        };
+
+        while (!finished) {
+            long now = nowMs();
+            if (next_stall != 0 && now >= next_stall) {
+                std::fprintf(stderr, "beatmap_stream: stalling for %ld ms\n", options.stall_for);
+                timespec pause{options.stall_for / 1000, (options.stall_for % 1000) * 1000000L};
+                nanosleep(&pause, nullptr);
+                next_stall = nowMs() + options.stall_every;
+                last_progress = nowMs();  // our own silence, not a lost record
+                continue;
+            }
+
+            if (!started && now - start_sent >= 1000) {  // (again) until the board answers
+                send(start);
+                start_sent = now;
+            }
+
+            pollfd pfd{port.fd(), POLLIN, 0};
+            if (poll(&pfd, 1, 50) > 0) {
+                uint8_t buffer[256];
+                ssize_t n = port.read(buffer, sizeof(buffer));
+                if (n <= 0) throw std::runtime_error("board closed the connection");
+                reader.feed(
+                    buffer, static_cast<size_t>(n),
+                    [&](const std::vector<uint8_t>& record) {
+                        if (!parseStatus(record, status)) return;
+                        if (!(status.flags & BEATSTREAM_STARTED)) {  // the board was reset, or lost the game
+                            started = false;
+                            start_sent = 0;
+                            sent = acked = 0;
+                            return;
+                        }
+                        if (!started && status.next_seq != 0) return;  // an answer to an older START
+                        started = true;
+                        size_t board = acked + static_cast<uint8_t>(status.next_seq - static_cast<uint8_t>(acked));
+                        if (board > acked && board <= records.size()) {
+                            acked = board;
+                            last_progress = nowMs();
+                        }
+                        if (sent < acked) sent = acked;
+                        finished = status.flags & BEATSTREAM_FINISHED;
+                    },
+                    [&](const std::vector<uint8_t>& text) {
+                        if (options.text) std::fwrite(text.data(), 1, text.size(), stderr);
+                    });
+            }
+            if (!started) continue;
+
+            now = nowMs();
+            if (sent > acked && now - last_progress >= 1000) {  // a record got lost: go back
+                resends += sent - acked;
+                sent = acked;
+                last_progress = now;
+            }
+            // EVENTS records need a free bank each; END needs none
+            while (sent < records.size() &&
+                   (sent - acked < status.credits || records[sent][0] == BEATSTREAM_END)) {
+                send(records[sent]);
+                sent++;
+                if (records[sent - 1][0] == BEATSTREAM_END) break;
+            }
+
+            if (now - last_report >= 1000) {
+                std::fprintf(stderr,
+                             "beatmap_stream: tick %u, %zu/%zu records taken, credits %u, "
+                             "underruns %u, late %u, rejected %u\n",
+                             status.tick, acked, records.size(), status.credits, status.underruns, status.late,
+                             status.rejected);
+                last_report = now;
+            }
+        }
+
+        std::fprintf(stderr,
+                     "beatmap_stream: done, %zu events in %zu records, %llu resent; board: tick %u, "
+                     "underruns %u, late %u, rejected %u\n",
+                     events.size(), records.size(), static_cast<unsigned long long>(resends), status.tick,
+                     status.underruns, status.late, status.rejected);
+    } catch (const std::exception& e) {
+        std::fprintf(stderr, "beatmap_stream: %s\n", e.what());
+        return 1;
+    }
+    return 0;
+}
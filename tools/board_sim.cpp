@@ -0,0 +1,310 @@
+// Stand-in for the board on a PTY, to test beatmap streaming and clock sync on Linux
+// without hardware. It runs the firmware's own libraries/beatstream/beatstream.c,
+// answers with the same status records, and ticks like a game in "map 2" mode.
+//
+//   board_sim [--speed X] [--menu-ms MS] [--expect events.csv]
+//             [--start-ms MS --tick-ms N --ticks N] [--drift-ppm X] [--jitter-ms MS]
+//
+// The first line on stdout is the PTY to give to beatmap_stream or conductor. Each
+// spawned event follows as "tick,event" (event in hex). With --expect, the spawned events
+// are compared with the CSV, and the exit status is 1 if any is missing or off its tick.
+//
+// For the conductor, --start-ms starts a game of --ticks ticks of --tick-ms without a
+// stream, and prints "tick,host_ms" for each tick instead. The simulated board clock runs
+// --drift-ppm fast (like a ceramic resonator off by that much) and follows TRIM; PINGs
+// wait up to --jitter-ms before they are answered, like a busy main loop.
+
+#include <fcntl.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "beatmap.hpp"
+#include "beatstream.h"
+#include "clocksync_protocol.h"
+#include "cobs.hpp"
+#include "telemetry_protocol.h"
+
+using namespace audiosurf;
+
+namespace {
+
+struct Options {
+    double speed = 1.0;  // game ticks run this many times faster than the map's tempo
+    long menu_ms = 2000; // time between START and the first game tick (the level menu)
+    std::string expect;
+    long start_ms = 0;   // 0: games start with a stream
+    int tick_ms = 488;
+    long ticks = 600;
+    double drift_ppm = 0;
+    double jitter_ms = 0;
+};
+
+void usage() {
+    std::fprintf(stderr,
+                 "usage: board_sim [--speed X] [--menu-ms MS] [--expect events.csv] "
+                 "[--start-ms MS --tick-ms N --ticks N] [--drift-ppm X] [--jitter-ms MS]\n");
+    std::exit(2);
+}
+
+Options parseArgs(int argc, char** argv) {
+    Options options;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--speed" && i + 1 < argc) options.speed = std::atof(argv[++i]);
+        else if (arg == "--menu-ms" && i + 1 < argc) options.menu_ms = std::atol(argv[++i]);
+        else if (arg == "--expect" && i + 1 < argc) options.expect = argv[++i];
+        else if (arg == "--start-ms" && i + 1 < argc) options.start_ms = std::atol(argv[++i]);
+        else if (arg == "--tick-ms" && i + 1 < argc) options.tick_ms = std::atoi(argv[++i]);
+        else if (arg == "--ticks" && i + 1 < argc) options.ticks = std::atol(argv[++i]);
+        else if (arg == "--drift-ppm" && i + 1 < argc) options.drift_ppm = std::atof(argv[++i]);
+        else if (arg == "--jitter-ms" && i + 1 < argc) options.jitter_ms = std::atof(argv[++i]);
+        else usage();
+    }
+    if (options.speed <= 0 || options.tick_ms <= 0 || options.ticks <= 0 || options.jitter_ms < 0) usage();
+    return options;
+}
+
+double nowMs() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+// The board's millisecond counter: Timer1 counts at 2 MHz off a clock drift_ppm fast,
+// and the ISR adds 2000 + trim / 256 counts to the compare register per millisecond
+class BoardClock {
+public:
+    BoardClock(double start, double drift_ppm) : host_(start), drift_(drift_ppm * 1e-6) {}
+
+    // Board time (ms, fractional) at a host time
+    double at(double host) {
+        ms_ += (host - host_) * rate();
+        host_ = host;
+        return ms_;
+    }
+
+    // Host ms until the board reaches board_ms
+    double hostUntil(double board_ms) const { return (board_ms - ms_) / rate(); }
+
+    void setTrim(int16_t trim) { trim_ = trim; }
+
+private:
+    double rate() const {
+        return (1 + drift_) * CLOCKSYNC_COUNTS_PER_MS / (CLOCKSYNC_COUNTS_PER_MS + trim_ / 256.0);
+    }
+
+    double host_;
+    double ms_ = 0;
+    double drift_;
+    int16_t trim_ = 0;
+};
+
+void sendRecord(int fd, std::vector<uint8_t> record) {
+    std::vector<uint8_t> frame = encodeFrame(record);
+    if (write(fd, frame.data(), frame.size()) < 0) {
+        // Nobody has the PTY open yet: the host asks again
+    }
+}
+
+void putU16(std::vector<uint8_t>& record, uint16_t value) {
+    record.push_back(value & 0xFF);
+    record.push_back(value >> 8);
+}
+
+void sendStatus(int fd, uint16_t time) {
+    BeatstreamStatus status;
+    beatstreamGetStatus(&status);
+    std::vector<uint8_t> record{TELEMETRY_STREAM, static_cast<uint8_t>(time & 0xFF), static_cast<uint8_t>(time >> 8),
+                                status.flags, status.next_seq, status.credits};
+    for (uint16_t value : {status.tick, status.underruns, status.late, status.rejected}) putU16(record, value);
+    sendRecord(fd, record);
+}
+
+struct Ping {
+    double due;  // host ms the main loop gets to it
+    std::vector<uint8_t> record;
+};
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    Options options = parseArgs(argc, argv);
+
+    std::vector<BeatEvent> expected;
+    if (!options.expect.empty()) {
+        std::string error;
+        if (!readBeatmapCsv(options.expect, expected, error)) {
+            std::fprintf(stderr, "board_sim: %s\n", error.c_str());
+            return 1;
+        }
+        std::stable_sort(expected.begin(), expected.end(),
+                         [](const BeatEvent& a, const BeatEvent& b) { return a.tick < b.tick; });
+    }
+
+    int master = posix_openpt(O_RDWR | O_NOCTTY);
+    if (master < 0 || grantpt(master) != 0 || unlockpt(master) != 0) {
+        std::perror("board_sim: pty");
+        return 1;
+    }
+    termios tio{};
+    tcgetattr(master, &tio);
+    cfmakeraw(&tio);
+    tcsetattr(master, TCSANOW, &tio);
+    std::printf("%s\n", ptsname(master));
+    std::fflush(stdout);
+
+    beatstreamReset();
+    FrameReader reader;
+    std::vector<BeatEvent> spawned;
+    double epoch = nowMs();
+    BoardClock clock(epoch, options.drift_ppm);
+    std::mt19937 random(1);
+    std::uniform_real_distribution<double> jitter(0, options.jitter_ms);
+    std::vector<Ping> pings;
+    bool syncing = false;       // a PING came in: report the game ticks
+    bool streaming = options.start_ms == 0;
+    double next_tick = streaming ? 0 : options.start_ms;  // board ms; 0: the game hasn't started
+    double tick_ms = options.tick_ms;
+    uint16_t game_tick = 0;
+    bool finished = false;
+
+    auto boardNow = [&]() { return static_cast<uint16_t>(static_cast<uint64_t>(clock.at(nowMs()))); };
+
+    while (!finished) {
+        double now = nowMs();
+        double board = clock.at(now);
+        double wake = now + 50;
+        if (next_tick != 0) wake = std::min(wake, now + clock.hostUntil(next_tick));
+        for (const Ping& ping : pings) wake = std::min(wake, ping.due);
+        int timeout = static_cast<int>(std::ceil(std::max(0.0, wake - now)));
+
+        pollfd pfd{master, POLLIN, 0};
+        if (poll(&pfd, 1, timeout) > 0 && (pfd.revents & POLLIN)) {
+            uint8_t buffer[256];
+            ssize_t n = read(master, buffer, sizeof(buffer));
+            if (n > 0) {
+                reader.feed(
+                    buffer, static_cast<size_t>(n),
+                    [&](const std::vector<uint8_t>& record) {
+                        if (record.empty()) return;
+                        if (record[0] == CLOCKSYNC_PING && record.size() == 1 + CLOCKSYNC_PING_SIZE) {
+                            pings.push_back({nowMs() + jitter(random), record});
+                            return;
+                        }
+                        if (record[0] == CLOCKSYNC_TRIM && record.size() == 1 + CLOCKSYNC_TRIM_SIZE) {
+                            clock.at(nowMs());
+                            clock.setTrim(static_cast<int16_t>(readU16(record.data() + 1)));
+                            return;
+                        }
+                        if (record[0] == CLOCKSYNC_NUDGE && record.size() == 1 + CLOCKSYNC_NUDGE_SIZE) {
+                            if (next_tick != 0) {
+                                int16_t shift = static_cast<int16_t>(readU16(record.data() + 1));
+                                next_tick = std::max(next_tick + shift, std::floor(clock.at(nowMs())) + 1);
+                            }
+                            return;
+                        }
+                        bool start = record[0] == BEATSTREAM_START;
+                        if (beatstreamReceive(record.data(), static_cast<uint8_t>(record.size()))) {
+                            sendStatus(master, boardNow());
+                        }
+                        if (streaming && start && beatstreamStarted()) {  // the player is in the level menu now
+                            spawned.clear();
+                            game_tick = 0;
+                            next_tick = std::floor(clock.at(nowMs())) + options.menu_ms;
+                        }
+                    },
+                    [](const std::vector<uint8_t>&) {});
+            }
+        }
+
+        now = nowMs();
+        board = clock.at(now);
+        for (auto ping = pings.begin(); ping != pings.end();) {
+            if (ping->due > now) {
+                ++ping;
+                continue;
+            }
+            // Stamped when the main loop reads it, like receiveClockSync()
+            syncing = true;
+            uint16_t ms = static_cast<uint16_t>(static_cast<uint64_t>(board));
+            uint16_t counts = static_cast<uint16_t>((board - std::floor(board)) * CLOCKSYNC_COUNTS_PER_MS);
+            std::vector<uint8_t> pong{TELEMETRY_PONG, static_cast<uint8_t>(ms & 0xFF), static_cast<uint8_t>(ms >> 8),
+                                      ping->record[1]};
+            pong.insert(pong.end(), ping->record.begin() + 2, ping->record.end());
+            putU16(pong, counts);
+            putU16(pong, 0);
+            sendRecord(master, pong);
+            ping = pings.erase(ping);
+        }
+
+        if (next_tick == 0 || board < next_tick) continue;
+
+        // One game tick, as updateGame() and spawnFromStream() do it
+        uint16_t tick_time = static_cast<uint16_t>(static_cast<uint64_t>(next_tick));
+        uint16_t period = streaming ? beatstreamTickMs() : options.tick_ms;
+        if (syncing) {
+            std::vector<uint8_t> record{TELEMETRY_GAME_TICK, static_cast<uint8_t>(tick_time & 0xFF),
+                                        static_cast<uint8_t>(tick_time >> 8)};
+            putU16(record, game_tick);
+            putU16(record, period);
+            sendRecord(master, record);
+        }
+        if (streaming) {
+            BeatstreamStatus status;
+            beatstreamGetStatus(&status);
+            uint8_t event;
+            while (beatstreamNextEvent(&event)) {
+                spawned.push_back({status.tick, event});
+                std::printf("%u,%02X\n", status.tick, event);
+            }
+            beatstreamTick();
+            sendStatus(master, tick_time);
+            finished = beatstreamFinished();
+            tick_ms = beatstreamTickMs() / options.speed;
+        } else {
+            std::printf("%u,%.3f\n", game_tick, now - epoch);
+            finished = game_tick + 1 >= options.ticks;
+        }
+        std::fflush(stdout);
+        game_tick++;
+        next_tick += tick_ms;
+    }
+
+    if (streaming) {
+        BeatstreamStatus status;
+        beatstreamGetStatus(&status);
+        std::fprintf(stderr, "board_sim: %zu events spawned in %u ticks, underruns %u, late %u, rejected %u\n",
+                     spawned.size(), status.tick, status.underruns, status.late, status.rejected);
+    } else {
+        std::fprintf(stderr, "board_sim: %u game ticks\n", game_tick);
+    }
+
+    int result = 0;
+    if (!options.expect.empty()) {
+        size_t missing = 0;
+        size_t matched = 0;
+        for (const BeatEvent& want : expected) {
+            auto it = std::find_if(spawned.begin(), spawned.end(), [&](const BeatEvent& got) {
+                return got.tick == want.tick && got.event == want.event;
+            });
+            if (it == spawned.end()) missing++;
+            else matched++;
+        }
+        std::fprintf(stderr, "board_sim: %zu of %zu expected events on their tick, %zu missing\n", matched,
+                     expected.size(), missing);
+        if (missing != 0 || spawned.size() != expected.size()) result = 1;
+    }
+    usleep(200000);  // let the host read the last status
+    close(master);
+    return result;
+}
@@ -0,0 +1,213 @@
+// Beatmap encoder and decoder, matching libraries/beatmap.
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "beatmap_format.h"
+
+namespace audiosurf {
+
+struct BeatEvent {
+    uint32_t tick;  // game ticks from the start of the map
+    uint8_t event;  // BEATMAP_EVENT(...)
+};
+
+inline void putVarint(std::vector<uint8_t>& out, uint32_t value) {
+    while (value >= 0x80) {
+        out.push_back(static_cast<uint8_t>(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<uint8_t>(value));
+}
+
+// Keeps the low 16 bits, as the firmware's reader does, so a map with larger values
+// fails the round trip instead of playing differently on the board
+inline bool getVarint(const std::vector<uint8_t>& in, size_t& i, uint32_t& value) {
+    value = 0;
+    for (int shift = 0; i < in.size() && shift < 21; shift += 7) {
+        uint8_t byte = in[i++];
+        value |= static_cast<uint32_t>(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) {
+            value &= 0xFFFF;
+            return true;
+        }
+    }
+    return false;
+}
+
+// Encodes events (any order; sorted by tick here, events of one tick keep their order).
+// Identical events at a constant spacing become one run record (longer runs, several).
+// Returns an empty vector if two consecutive events are more than BEATMAP_MAX_DELTA apart.
+inline std::vector<uint8_t> encodeBeatmap(std::vector<BeatEvent> events, uint16_t tick_ms,
+                                          size_t* runs = nullptr) {
+    std::stable_sort(events.begin(), events.end(),
+                     [](const BeatEvent& a, const BeatEvent& b) { return a.tick < b.tick; });
+
+    std::vector<uint8_t> out{BEATMAP_MAGIC_0, BEATMAP_MAGIC_1, BEATMAP_VERSION,
+                             static_cast<uint8_t>(tick_ms & 0xFF), static_cast<uint8_t>(tick_ms >> 8)};
+    if (runs) *runs = 0;
+
+    uint32_t previous = 0;
+    for (size_t i = 0; i < events.size();) {
+        uint32_t delta = events[i].tick - previous;
+        if (delta > BEATMAP_MAX_DELTA) return {};
+
+        // Longest run of the same event at the spacing of its first repeat
+        size_t end = i + 1;
+        uint32_t period = 0;
+        if (end < events.size() && events[end].event == events[i].event &&
+            events[end].tick - events[i].tick <= BEATMAP_MAX_RUN) {
+            period = events[end].tick - events[i].tick;
+            while (end < events.size() && end - i <= BEATMAP_MAX_RUN && events[end].event == events[i].event &&
+                   events[end].tick - events[end - 1].tick == period) {
+                end++;
+            }
+        }
+        uint32_t repeats = static_cast<uint32_t>(end - i - 1);
+
+        if (repeats >= 2) {  // a run record pays off from the third event on
+            putVarint(out, (delta << 1) | 1);
+            out.push_back(events[i].event);
+            putVarint(out, repeats);
+            putVarint(out, period);
+            if (runs) (*runs)++;
+            previous = events[end - 1].tick;
+            i = end;
+        } else {
+            putVarint(out, delta << 1);
+            out.push_back(events[i].event);
+            previous = events[i].tick;
+            i++;
+        }
+    }
+    putVarint(out, 0);
+    out.push_back(BEATMAP_END);
+    return out;
+}
+
+// Expands a beatmap back into events. Returns false if it is malformed.
+inline bool decodeBeatmap(const std::vector<uint8_t>& in, std::vector<BeatEvent>& events,
+                          uint16_t* tick_ms = nullptr) {
+    events.clear();
+    if (in.size() < BEATMAP_HEADER_SIZE || in[0] != BEATMAP_MAGIC_0 || in[1] != BEATMAP_MAGIC_1 ||
+        in[2] != BEATMAP_VERSION) {
+        return false;
+    }
+    if (tick_ms) *tick_ms = static_cast<uint16_t>(in[3] | (in[4] << 8));
+
+    size_t i = BEATMAP_HEADER_SIZE;
+    uint32_t tick = 0;
+    while (true) {
+        uint32_t delta, repeats = 0, period = 0;
+        if (!getVarint(in, i, delta) || i >= in.size()) return false;
+        uint8_t event = in[i++];
+        if (event == BEATMAP_END) return i == in.size();
+        if ((delta & 1) && (!getVarint(in, i, repeats) || !getVarint(in, i, period))) return false;
+
+        tick += delta >> 1;
+        events.push_back({tick, event});
+        for (uint32_t k = 0; k < repeats; k++) {
+            tick += period;
+            events.push_back({tick, event});
+        }
+    }
+}
+
+// True if the map decodes to exactly these events (sorted by tick)
+inline bool beatmapRoundTrips(const std::vector<uint8_t>& map, std::vector<BeatEvent> events) {
+    std::stable_sort(events.begin(), events.end(),
+                     [](const BeatEvent& a, const BeatEvent& b) { return a.tick < b.tick; });
+    std::vector<BeatEvent> check;
+    bool same = decodeBeatmap(map, check) && check.size() == events.size();
+    for (size_t i = 0; same && i < events.size(); i++) {
+        same = check[i].tick == events[i].tick && check[i].event == events[i].event;
+    }
+    return same;
+}
+
+// Writes a packed map as a C header for src/maps/
+inline void writeBeatmapHeader(FILE* out, const char* tool, const std::string& name, const std::vector<uint8_t>& map,
+                               size_t events, size_t runs, uint32_t ticks, int tick_ms) {
+    std::fprintf(out, "// Generated by tools/%s - do not edit.\n", tool);
+    std::fprintf(out, "// %zu events (%zu runs) over %u ticks of %d ms, %zu bytes\n", events, runs, ticks, tick_ms,
+                 map.size());
+    // NAME_MAP_H: the default name BEATMAP would take beatmap.h's guard
+    std::fprintf(out, "#ifndef %s_MAP_H\n#define %s_MAP_H\n\n", name.c_str(), name.c_str());
+    std::fprintf(out, "static const uint8_t %s[] PROGMEM = {", name.c_str());
+    for (size_t i = 0; i < map.size(); i++) {
+        std::fprintf(out, "%s0x%02X%s", i % 12 == 0 ? "\n    " : " ", map[i], i + 1 < map.size() ? "," : "");
+    }
+    std::fprintf(out, "\n};\n\n#endif\n");
+}
+
+// Parses one CSV line,  tick,position,kind[,slow[,drift[,count,period]]]  (see tools/README.md),
+// and appends its events. Returns an error message or nullptr.
+inline const char* parseBeatmapCsvLine(const std::string& line, std::vector<BeatEvent>& events) {
+    std::vector<std::string> fields;
+    std::stringstream stream(line);
+    std::string field;
+    while (std::getline(stream, field, ',')) fields.push_back(field);
+    if (fields.size() < 3 || fields.size() > 7 || fields.size() == 6) return "expected 3, 4, 5 or 7 fields";
+
+    long tick = std::atol(fields[0].c_str());
+    int position = std::atoi(fields[1].c_str());
+    int kind = fields[2] == "block" ? BEATMAP_BLOCK
+             : fields[2] == "wall" ? BEATMAP_WALL
+             : fields[2] == "powerup" ? BEATMAP_POWERUP : -1;
+    int slow = fields.size() > 3 ? std::atoi(fields[3].c_str()) : 0;
+    int drift = fields.size() > 4 ? std::atoi(fields[4].c_str()) : 0;
+    long count = fields.size() > 5 ? std::atol(fields[5].c_str()) : 0;
+    long period = fields.size() > 6 ? std::atol(fields[6].c_str()) : 0;
+
+    if (tick < 0) return "negative tick";
+    if (position < 0 || position > 7) return "position must be 0-7";
+    if (kind < 0) return "kind must be block, wall or powerup";
+    if (slow != 0 && slow != 1) return "slow must be 0 or 1";
+    if (drift < -1 || drift > 1) return "drift must be -1, 0 or 1";
+    if (kind == BEATMAP_WALL && position > BEATMAP_WALL_MAX_POSITION) return "a wall's position must be 0-5";
+    if (kind == BEATMAP_WALL && drift != 0) return "walls do not drift";
+    if (count < 0 || (count > 0 && period <= 0)) return "a repeat needs a count and a positive period";
+    if (count > BEATMAP_MAX_RUN || period > BEATMAP_MAX_RUN) return "count and period must be at most 65535";
+
+    uint8_t drift_bits = drift > 0 ? BEATMAP_DRIFT_DOWN : drift < 0 ? BEATMAP_DRIFT_UP : BEATMAP_DRIFT_NONE;
+    uint8_t event = BEATMAP_EVENT(position, kind, slow, drift_bits);
+    for (long k = 0; k <= count; k++) {
+        events.push_back({static_cast<uint32_t>(tick + k * period), event});
+    }
+    return nullptr;
+}
+
+// Reads a CSV event list ("-" is stdin), skipping blank lines and '#' comments
+inline bool readBeatmapCsv(const std::string& path, std::vector<BeatEvent>& events, std::string& error) {
+    std::ifstream file;
+    if (path != "-") {
+        file.open(path);
+        if (!file) {
+            error = "cannot open " + path;
+            return false;
+        }
+    }
+    std::istream& input = path == "-" ? std::cin : file;
+
+    std::string line;
+    for (int number = 1; std::getline(input, line); number++) {
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        if (line.empty() || line[0] == '#') continue;
+        if (const char* message = parseBeatmapCsvLine(line, events)) {
+            error = "line " + std::to_string(number) + ": " + message;
+            return false;
+        }
+    }
+    return true;
+}
+
+}  // namespace audiosurf
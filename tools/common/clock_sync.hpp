@@ -0,0 +1,126 @@
+// Board clock estimation from PING/PONG round trips (see libraries/clocksync).
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <deque>
+#include <vector>
+
+namespace audiosurf {
+
+// Host microseconds per ppm of trim: one trim step is 1/256 count of a 2000-count millisecond
+constexpr double CLOCKSYNC_PPM_PER_TRIM = 1e6 / (256.0 * 2000.0);
+
+class ClockEstimator {
+public:
+    // One round trip, in microseconds: when the PING left, when the PONG came back,
+    // and the board's time stamp in between
+    void add(double sent, double received, double board) {
+        Sample sample{(sent + received) / 2, received - sent, board - (sent + received) / 2};
+        recent_.push_back(sample);
+        if (recent_.size() > RECENT) recent_.pop_front();
+
+        // The fastest round trip of each second since the last rate change
+        if (!started_) {
+            started_ = true;
+            restart_ = sample.host;
+        }
+        long second = static_cast<long>((sample.host - restart_) / 1e6);
+        if (best_.empty() || second != best_second_) {
+            best_.push_back(sample);
+            best_second_ = second;
+        } else if (sample.rtt < best_.back().rtt) {
+            best_.back() = sample;
+        }
+        while (best_.size() > 1 && best_.back().host - best_.front().host > DRIFT_WINDOW) best_.erase(best_.begin());
+        fit();
+    }
+
+    bool ready() const { return !recent_.empty(); }
+
+    // Board minus host time, from the fastest recent round trip (the least queueing in it)
+    double offset() const { return fastest().offset; }
+    double rtt() const { return fastest().rtt; }
+
+    // Host time of a board time stamp
+    double hostTime(double board) const {
+        const Sample& base = fastest();
+        double host = board - base.offset;
+        return board - (base.offset + slope_ * (host - base.host));
+    }
+
+    // RMS distance of the recent offsets from the fastest one: what queueing adds
+    double jitter() const {
+        double sum = 0;
+        for (const Sample& s : recent_) sum += (s.offset - offset()) * (s.offset - offset());
+        return recent_.empty() ? 0 : std::sqrt(sum / recent_.size());
+    }
+
+    // How fast the board runs against the host (positive: fast), with its standard error.
+    // Known once the fastest round trips span DRIFT_MIN_SPAN.
+    bool driftKnown() const { return known_; }
+    double driftPpm() const { return slope_ * 1e6; }
+    double driftErrorPpm() const { return slope_error_ * 1e6; }
+
+    // The board's rate was changed: measure the drift from scratch
+    void restartDrift() {
+        best_.clear();
+        started_ = false;
+        known_ = false;
+        slope_ = slope_error_ = 0;
+    }
+
+private:
+    struct Sample {
+        double host;    // middle of the round trip
+        double rtt;
+        double offset;  // board - host
+    };
+
+    static constexpr size_t RECENT = 10;
+    static constexpr double DRIFT_WINDOW = 120e6;
+    static constexpr double DRIFT_MIN_SPAN = 5e6;
+
+    const Sample& fastest() const {
+        return *std::min_element(recent_.begin(), recent_.end(),
+                                 [](const Sample& a, const Sample& b) { return a.rtt < b.rtt; });
+    }
+
+    // Least squares line through the per-second fastest offsets
+    void fit() {
+        size_t n = best_.size();
+        if (n < 5 || best_.back().host - best_.front().host < DRIFT_MIN_SPAN) return;
+        double mean_x = 0, mean_y = 0;
+        for (const Sample& s : best_) {
+            mean_x += s.host;
+            mean_y += s.offset;
+        }
+        mean_x /= n;
+        mean_y /= n;
+        double sxx = 0, sxy = 0;
+        for (const Sample& s : best_) {
+            sxx += (s.host - mean_x) * (s.host - mean_x);
+            sxy += (s.host - mean_x) * (s.offset - mean_y);
+        }
+        slope_ = sxy / sxx;
+        double residuals = 0;
+        for (const Sample& s : best_) {
+            double r = s.offset - mean_y - slope_ * (s.host - mean_x);
+            residuals += r * r;
+        }
+        slope_error_ = std::sqrt(residuals / (n - 2) / sxx);
+        known_ = true;
+    }
+
+    std::deque<Sample> recent_;
+    std::vector<Sample> best_;
+    bool started_ = false;
+    double restart_ = 0;
+    long best_second_ = 0;
+    bool known_ = false;
+    double slope_ = 0;
+    double slope_error_ = 0;
+};
+
+}  // namespace audiosurf
@@ -0,0 +1,136 @@
+// COBS framing and CRC-16/CCITT-FALSE, matching libraries/telemetry.
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace audiosurf {
+
+inline uint16_t crc16Update(uint16_t crc, uint8_t byte) {
+    // Same as avr-libc _crc_xmodem_update: polynomial 0x1021, MSB first
+    crc ^= static_cast<uint16_t>(byte) << 8;
+    for (int i = 0; i < 8; i++) {
+        crc = (crc & 0x8000) ? static_cast<uint16_t>((crc << 1) ^ 0x1021) : static_cast<uint16_t>(crc << 1);
+    }
+    return crc;
+}
+
+inline uint16_t crc16(const uint8_t* data, size_t length, uint16_t crc = 0xFFFF) {
+    for (size_t i = 0; i < length; i++) crc = crc16Update(crc, data[i]);
+    return crc;
+}
+
+// Decodes one COBS block (without delimiters). Returns false on malformed input.
+inline bool cobsDecode(const uint8_t* in, size_t length, std::vector<uint8_t>& out) {
+    out.clear();
+    size_t i = 0;
+    while (i < length) {
+        uint8_t code = in[i++];
+        if (code == 0 || i + code - 1 > length) return false;
+        for (uint8_t k = 1; k < code; k++) out.push_back(in[i++]);
+        if (code != 0xFF && i < length) out.push_back(0);
+    }
+    return true;
+}
+
+inline void cobsEncode(const uint8_t* in, size_t length, std::vector<uint8_t>& out) {
+    size_t code_index = out.size();
+    out.push_back(0);
+    uint8_t code = 1;
+    for (size_t i = 0; i < length; i++) {
+        if (in[i] == 0) {
+            out[code_index] = code;
+            code_index = out.size();
+            out.push_back(0);
+            code = 1;
+            continue;
+        }
+        out.push_back(in[i]);
+        if (++code == 0xFF) {
+            out[code_index] = code;
+            code_index = out.size();
+            out.push_back(0);
+            code = 1;
+        }
+    }
+    out[code_index] = code;
+}
+
+// Builds a complete wire frame: 0x00, COBS(record + crc), 0x00
+inline std::vector<uint8_t> encodeFrame(const std::vector<uint8_t>& record) {
+    std::vector<uint8_t> raw(record);
+    uint16_t crc = crc16(record.data(), record.size());
+    raw.push_back(crc & 0xFF);
+    raw.push_back(crc >> 8);
+    std::vector<uint8_t> frame{0};
+    cobsEncode(raw.data(), raw.size(), frame);
+    frame.push_back(0);
+    return frame;
+}
+
+// Splits a byte stream at 0x00 delimiters. Chunks that decode and pass the
+// CRC are records; anything else is plain text sharing the line.
+class FrameReader {
+public:
+    template <typename OnRecord, typename OnText>
+    void feed(const uint8_t* data, size_t length, OnRecord onRecord, OnText onText) {
+        for (size_t i = 0; i < length; i++) {
+            if (data[i] != 0) {
+                chunk_.push_back(data[i]);
+                continue;
+            }
+            if (!chunk_.empty()) {
+                if (cobsDecode(chunk_.data(), chunk_.size(), record_) && record_.size() > 2 &&
+                    crc16(record_.data(), record_.size() - 2) ==
+                        (record_[record_.size() - 2] | (record_[record_.size() - 1] << 8))) {
+                    record_.resize(record_.size() - 2);
+                    frames_++;
+                    onRecord(record_);
+                } else {
+                    rejected_++;
+                    onText(chunk_);
+                }
+                chunk_.clear();
+            }
+        }
+    }
+
+    uint64_t frames() const { return frames_; }
+    uint64_t rejected() const { return rejected_; }
+
+private:
+    std::vector<uint8_t> chunk_;
+    std::vector<uint8_t> record_;
+    uint64_t frames_ = 0;
+    uint64_t rejected_ = 0;
+};
+
+// Extends the device's 16-bit millisecond timestamps to 64 bits.
+// Works as long as consecutive records are less than 32 s apart.
+class TimestampUnwrapper {
+public:
+    uint64_t operator()(uint16_t stamp) {
+        if (!started_) {
+            started_ = true;
+            last_ = stamp;
+            current_ = stamp;
+            return current_;
+        }
+        int16_t delta = static_cast<int16_t>(stamp - last_);  // shortest signed distance
+        if (delta < 0) return current_ + delta;  // a late record, don't move the clock back
+        last_ = stamp;
+        current_ += delta;
+        return current_;
+    }
+
+private:
+    bool started_ = false;
+    uint16_t last_ = 0;
+    uint64_t current_ = 0;
+};
+
+inline uint16_t readU16(const uint8_t* p) { return static_cast<uint16_t>(p[0] | (p[1] << 8)); }
+inline uint32_t readU32(const uint8_t* p) { return readU16(p) | (static_cast<uint32_t>(readU16(p + 2)) << 16); }
+
+}  // namespace audiosurf
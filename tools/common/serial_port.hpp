@@ -0,0 +1,88 @@
+// Minimal raw serial port / PTY / file access for the host tools (Linux).
+#pragma once
+
+#include <fcntl.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+namespace audiosurf {
+
+inline speed_t baudConstant(int baud) {
+    switch (baud) {
+        case 9600: return B9600;
+        case 19200: return B19200;
+        case 38400: return B38400;
+        case 57600: return B57600;
+        case 115200: return B115200;
+        case 230400: return B230400;
+        default: throw std::runtime_error("unsupported baud rate " + std::to_string(baud));
+    }
+}
+
+class SerialPort {
+public:
+    // "-" means stdin. Terminals (real ports and PTYs) are switched to raw mode.
+    explicit SerialPort(const std::string& path, int baud = 9600, bool writable = false) {
+        if (path == "-") {
+            fd_ = STDIN_FILENO;
+            return;
+        }
+        fd_ = ::open(path.c_str(), (writable ? O_RDWR : O_RDONLY) | O_NOCTTY);
+        if (fd_ < 0) throw std::runtime_error(path + ": " + std::strerror(errno));
+        owned_ = true;
+        if (isatty(fd_)) {
+            termios tio{};
+            if (tcgetattr(fd_, &tio) != 0) throw std::runtime_error(path + ": tcgetattr failed");
+            cfmakeraw(&tio);
+            cfsetispeed(&tio, baudConstant(baud));
+            cfsetospeed(&tio, baudConstant(baud));
+            tio.c_cflag |= CLOCAL | CREAD;
+            tio.c_cc[VMIN] = 1;
+            tio.c_cc[VTIME] = 0;
+            if (tcsetattr(fd_, TCSANOW, &tio) != 0) throw std::runtime_error(path + ": tcsetattr failed");
+        }
+    }
+
+    ~SerialPort() {
+        if (owned_) ::close(fd_);
+    }
+
+    SerialPort(const SerialPort&) = delete;
+    SerialPort& operator=(const SerialPort&) = delete;
+
+    int fd() const { return fd_; }
+
+    // Returns bytes read, 0 at end of file, -1 on error (EINTR is retried)
+    ssize_t read(void* buffer, size_t length) {
+        while (true) {
+            ssize_t n = ::read(fd_, buffer, length);
+            if (n < 0 && errno == EINTR) continue;
+            return n;
+        }
+    }
+
+    bool writeAll(const void* data, size_t length) {
+        const uint8_t* p = static_cast<const uint8_t*>(data);
+        while (length > 0) {
+            ssize_t n = ::write(fd_, p, length);
+            if (n < 0) {
+                if (errno == EINTR) continue;
+                return false;
+            }
+            p += n;
+            length -= static_cast<size_t>(n);
+        }
+        return true;
+    }
+
+private:
+    int fd_ = -1;
+    bool owned_ = false;
+};
+
+}  // namespace audiosurf
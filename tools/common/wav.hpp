@@ -0,0 +1,87 @@
+// PCM WAV reader for the host tools: integer (8/16/24/32 bit) and float samples,
+// any channel count, mixed down to mono floats in [-1, 1].
+#pragma once
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace audiosurf {
+
+struct Audio {
+    uint32_t rate = 0;
+    std::vector<float> samples;  // mono
+
+    double seconds() const { return rate ? static_cast<double>(samples.size()) / rate : 0.0; }
+};
+
+inline Audio readWav(const std::string& path) {
+    FILE* file = std::fopen(path.c_str(), "rb");
+    if (!file) throw std::runtime_error(path + ": " + std::strerror(errno));
+    std::vector<uint8_t> data;
+    uint8_t buffer[1 << 16];
+    size_t n;
+    while ((n = std::fread(buffer, 1, sizeof(buffer), file)) > 0) data.insert(data.end(), buffer, buffer + n);
+    std::fclose(file);
+
+    auto u16 = [&](size_t at) { return static_cast<uint32_t>(data[at] | (data[at + 1] << 8)); };
+    auto u32 = [&](size_t at) { return u16(at) | (u16(at + 2) << 16); };
+    if (data.size() < 12 || std::memcmp(&data[0], "RIFF", 4) != 0 || std::memcmp(&data[8], "WAVE", 4) != 0) {
+        throw std::runtime_error(path + ": not a WAV file");
+    }
+
+    uint32_t format = 0, channels = 0, bits = 0;
+    Audio audio;
+    size_t samples_at = 0, samples_size = 0;
+    for (size_t at = 12; at + 8 <= data.size();) {
+        uint32_t size = u32(at + 4);
+        size_t body = at + 8;
+        if (std::memcmp(&data[at], "fmt ", 4) == 0 && size >= 16 && body + size <= data.size()) {
+            format = u16(body);
+            channels = u16(body + 2);
+            audio.rate = u32(body + 4);
+            bits = u16(body + 14);
+            if (format == 0xFFFE && size >= 26) format = u16(body + 24);  // WAVE_FORMAT_EXTENSIBLE
+        } else if (std::memcmp(&data[at], "data", 4) == 0) {
+            samples_at = body;
+            samples_size = std::min<size_t>(size, data.size() - body);
+        }
+        at = body + size + (size & 1);
+    }
+    bool pcm = format == 1 && (bits == 8 || bits == 16 || bits == 24 || bits == 32);
+    bool ieee = format == 3 && bits == 32;
+    if (!samples_at || !channels || !audio.rate || !(pcm || ieee)) {
+        throw std::runtime_error(path + ": unsupported WAV format (PCM 8/16/24/32 bit or float 32 bit)");
+    }
+
+    size_t width = bits / 8;
+    size_t frames = samples_size / (width * channels);
+    audio.samples.resize(frames);
+    const uint8_t* p = &data[samples_at];
+    for (size_t i = 0; i < frames; i++) {
+        float sum = 0;
+        for (uint32_t c = 0; c < channels; c++, p += width) {
+            if (ieee) {
+                float value;
+                std::memcpy(&value, p, 4);
+                sum += value;
+            } else if (bits == 8) {
+                sum += (p[0] - 128) / 128.0f;
+            } else {
+                // Little-endian signed integer, sign-extended from the top byte
+                int32_t value = static_cast<int8_t>(p[width - 1]);
+                for (size_t b = width - 1; b-- > 0;) value = (value << 8) | p[b];
+                sum += static_cast<float>(value) / static_cast<float>(1u << (bits - 1));
+            }
+        }
+        audio.samples[i] = sum / channels;
+    }
+    return audio;
+}
+
+}  // namespace audiosurf
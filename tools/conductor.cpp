@@ -0,0 +1,302 @@
+// Keeps a game on the music: starts the track when a game starts and locks the
+// board's game ticks to it (see libraries/clocksync/clocksync_protocol.h).
+//
+//   conductor [--baud N] [--play CMD] [--latency-ms MS] [--phase-ms MS] [--ping-ms MS]
+//             [--no-trim] [--seconds S] <device>
+//
+// It pings the board ten times a second and estimates the offset between the clocks
+// from the fastest round trips, and the board's drift from how that offset moves; the
+// drift is trimmed out of the board's millisecond. When a game starts, CMD is run (the
+// player, e.g. "ffplay -nodisp -autoexit track.mp3"), and every game tick k is held at
+// --phase-ms + k * tick into the track with small nudges. --latency-ms is how long the
+// player takes to make a sound. Once a second it prints the offset, round trip, jitter,
+// drift, trim and the game's error to stderr.
+//
+// The board's text goes to stdout and lines typed on stdin go to the board, so it
+// replaces the serial monitor.
+
+#include <poll.h>
+#include <signal.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include "clock_sync.hpp"
+#include "clocksync_protocol.h"
+#include "cobs.hpp"
+#include "serial_port.hpp"
+#include "telemetry_protocol.h"
+
+using namespace audiosurf;
+
+namespace {
+
+constexpr double NUDGE_DEADBAND_MS = 2;  // errors below this are left alone
+constexpr double NUDGE_STEP_MS = 5;      // larger ones are walked off this much per tick...
+constexpr double NUDGE_JUMP_MS = 100;    // ... unless they are this large (a game start)
+
+struct Options {
+    std::string device;
+    int baud = 9600;
+    std::string play;
+    double latency_ms = 0;
+    double phase_ms = 0;
+    long ping_ms = 100;
+    bool trim = true;
+    double seconds = 0;  // 0: until interrupted
+};
+
+void usage() {
+    std::fprintf(stderr,
+                 "usage: conductor [--baud N] [--play CMD] [--latency-ms MS] [--phase-ms MS] [--ping-ms MS] "
+                 "[--no-trim] [--seconds S] <device>\n");
+    std::exit(2);
+}
+
+Options parseArgs(int argc, char** argv) {
+    Options options;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--baud" && i + 1 < argc) options.baud = std::atoi(argv[++i]);
+        else if (arg == "--play" && i + 1 < argc) options.play = argv[++i];
+        else if (arg == "--latency-ms" && i + 1 < argc) options.latency_ms = std::atof(argv[++i]);
+        else if (arg == "--phase-ms" && i + 1 < argc) options.phase_ms = std::atof(argv[++i]);
+        else if (arg == "--ping-ms" && i + 1 < argc) options.ping_ms = std::atol(argv[++i]);
+        else if (arg == "--no-trim") options.trim = false;
+        else if (arg == "--seconds" && i + 1 < argc) options.seconds = std::atof(argv[++i]);
+        else if (!arg.empty() && arg[0] != '-' && options.device.empty()) options.device = arg;
+        else usage();
+    }
+    if (options.device.empty() || options.ping_ms <= 0) usage();
+    return options;
+}
+
+volatile sig_atomic_t g_stop = 0;
+
+void onSignal(int) {
+    g_stop = 1;
+}
+
+double nowUs() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+// The music player, in its own process group so the whole pipeline can be stopped
+class Player {
+public:
+    explicit Player(std::string command) : command_(std::move(command)) {}
+    ~Player() { stop(); }
+
+    void start() {
+        stop();
+        if (command_.empty()) return;
+        pid_ = fork();
+        if (pid_ == 0) {
+            setpgid(0, 0);
+            execl("/bin/sh", "sh", "-c", command_.c_str(), static_cast<char*>(nullptr));
+            _exit(127);
+        }
+    }
+
+    void stop() {
+        if (pid_ <= 0) return;
+        kill(-pid_, SIGTERM);
+        kill(pid_, SIGTERM);
+        waitpid(pid_, nullptr, 0);
+        pid_ = -1;
+    }
+
+private:
+    std::string command_;
+    pid_t pid_ = -1;
+};
+
+void putU16(std::vector<uint8_t>& record, uint16_t value) {
+    record.push_back(value & 0xFF);
+    record.push_back(value >> 8);
+}
+
+// Where the game is against the music
+struct Game {
+    bool running = false;
+    bool locked = false;        // the ticks keep the tempo of tick 0
+    double audio_start = 0;     // host time of the track's first sample coming out
+    uint16_t period = 0;
+    uint16_t tick = 0;
+    uint16_t settled_tick = 0;  // ticks before this one may not show the last nudge yet
+    double error = 0;           // ms, positive: the tick came late
+    double error_squares = 0;   // since the last report
+    int errors = 0;
+    long nudged = 0;            // ms, since the last report
+};
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    Options options = parseArgs(argc, argv);
+    signal(SIGINT, onSignal);
+    signal(SIGTERM, onSignal);
+
+    try {
+        SerialPort port(options.device, options.baud, true);
+        FrameReader reader;
+        TimestampUnwrapper board_ms;
+        ClockEstimator clock;
+        Player player(options.play);
+        Game game;
+
+        double epoch = nowUs();
+        double next_ping = epoch;
+        double next_report = epoch + 1e6;
+        uint8_t seq = 0;
+        int16_t trim = 0;
+        bool stdin_open = true;
+
+        auto send = [&](const std::vector<uint8_t>& record) {
+            std::vector<uint8_t> frame = encodeFrame(record);
+            if (!port.writeAll(frame.data(), frame.size())) throw std::runtime_error("write failed");
+        };
+
+        auto onPong = [&](double received, const uint8_t* p, uint64_t ms) {
+            uint32_t echo = readU32(p + 1);
+            uint32_t now32 = static_cast<uint32_t>(static_cast<uint64_t>(received - epoch));
+            double sent = received - static_cast<uint32_t>(now32 - echo);
+            double board = ms * 1000.0 + readU16(p + 5) * 1000.0 / CLOCKSYNC_COUNTS_PER_MS;
+            clock.add(sent, received, board);
+        };
+
+        auto onGameTick = [&](double received, const uint8_t* p, uint64_t ms) {
+            uint16_t tick = readU16(p);
+            uint16_t period = readU16(p + 2);
+            if (!game.running && tick != 0) return;  // joined mid-game: wait for the next one
+            if (!game.running || tick <= game.tick) {  // a new game: start the music
+                player.start();
+                game = Game();
+                game.running = true;
+                game.locked = true;
+                game.audio_start = received + options.latency_ms * 1000;
+                game.period = period;
+                std::fprintf(stderr, "conductor: game started, %u ms per tick, music %s\n", period,
+                             options.play.empty() ? "assumed playing" : "started");
+            }
+            game.tick = tick;
+            if (period != game.period && game.locked) {
+                game.locked = false;
+                std::fprintf(stderr, "conductor: tick changed to %u ms (the map is over), not locking\n", period);
+            }
+            if (!game.locked || !clock.ready()) return;
+
+            double target = game.audio_start + (options.phase_ms + static_cast<double>(tick) * game.period) * 1000;
+            game.error = (clock.hostTime(ms * 1000.0) - target) / 1000;
+            game.error_squares += game.error * game.error;
+            game.errors++;
+
+            if (tick < game.settled_tick || std::fabs(game.error) < NUDGE_DEADBAND_MS) return;
+            double shift = -game.error;
+            if (std::fabs(shift) < NUDGE_JUMP_MS) shift = std::max(-NUDGE_STEP_MS, std::min(NUDGE_STEP_MS, shift));
+            int16_t value = static_cast<int16_t>(std::lround(shift));
+            std::vector<uint8_t> record{CLOCKSYNC_NUDGE};
+            putU16(record, static_cast<uint16_t>(value));
+            send(record);
+            game.nudged += value;
+            game.settled_tick = tick + 2;  // the next tick may already be on its way
+        };
+
+        while (!g_stop) {
+            double now = nowUs();
+            if (options.seconds > 0 && now - epoch >= options.seconds * 1e6) break;
+
+            if (now >= next_ping) {
+                uint32_t stamp = static_cast<uint32_t>(static_cast<uint64_t>(nowUs() - epoch));
+                std::vector<uint8_t> record{CLOCKSYNC_PING, seq++};
+                putU16(record, stamp & 0xFFFF);
+                putU16(record, stamp >> 16);
+                send(record);
+                next_ping += options.ping_ms * 1000.0;
+                if (next_ping < now) next_ping = now + options.ping_ms * 1000.0;
+            }
+
+            pollfd fds[2] = {{port.fd(), POLLIN, 0}, {STDIN_FILENO, POLLIN, 0}};
+            int timeout = static_cast<int>(std::max(0.0, std::min(next_ping, next_report) - nowUs()) / 1000) + 1;
+            if (poll(fds, stdin_open ? 2 : 1, timeout) < 0) continue;  // a signal
+
+            if (fds[0].revents & (POLLIN | POLLHUP)) {
+                uint8_t buffer[256];
+                ssize_t n = port.read(buffer, sizeof(buffer));
+                if (n <= 0) throw std::runtime_error("board closed the connection");
+                double received = nowUs();
+                reader.feed(
+                    buffer, static_cast<size_t>(n),
+                    [&](const std::vector<uint8_t>& record) {
+                        if (record.size() < TELEMETRY_HEADER_SIZE) return;
+                        uint64_t ms = board_ms(readU16(record.data() + 1));
+                        const uint8_t* p = record.data() + TELEMETRY_HEADER_SIZE;
+                        size_t size = record.size() - TELEMETRY_HEADER_SIZE;
+                        if (record[0] == TELEMETRY_PONG && size == TELEMETRY_PONG_SIZE) onPong(received, p, ms);
+                        if (record[0] == TELEMETRY_GAME_TICK && size == TELEMETRY_GAME_TICK_SIZE) {
+                            onGameTick(received, p, ms);
+                        }
+                    },
+                    [](const std::vector<uint8_t>& text) {
+                        std::fwrite(text.data(), 1, text.size(), stdout);
+                        std::fflush(stdout);
+                    });
+            }
+            if (stdin_open && (fds[1].revents & (POLLIN | POLLHUP))) {
+                char line[256];
+                ssize_t n = read(STDIN_FILENO, line, sizeof(line));
+                if (n <= 0) stdin_open = false;
+                else if (!port.writeAll(line, static_cast<size_t>(n))) throw std::runtime_error("write failed");
+            }
+
+            now = nowUs();
+            if (now < next_report) continue;
+            next_report += 1e6;
+
+            // Trim out the drift once it is known better than it is large
+            if (options.trim && clock.driftKnown() && std::fabs(clock.driftPpm()) > 2 * clock.driftErrorPpm()) {
+                long correction = std::lround(clock.driftPpm() / CLOCKSYNC_PPM_PER_TRIM);
+                if (correction != 0) {
+                    trim = static_cast<int16_t>(
+                        std::max<long>(-CLOCKSYNC_TRIM_MAX, std::min<long>(CLOCKSYNC_TRIM_MAX, trim + correction)));
+                    std::vector<uint8_t> record{CLOCKSYNC_TRIM};
+                    putU16(record, static_cast<uint16_t>(trim));
+                    send(record);
+                    clock.restartDrift();
+                }
+            }
+
+            if (!clock.ready()) {
+                std::fprintf(stderr, "conductor: %.0f s, no answer from the board\n", (now - epoch) / 1e6);
+                continue;
+            }
+            std::fprintf(stderr,
+                         "conductor: %.0f s, offset %+.3f ms, rtt %.2f ms, jitter %.3f ms, trim %+d (%+.1f ppm)",
+                         (now - epoch) / 1e6, clock.offset() / 1000, clock.rtt() / 1000, clock.jitter() / 1000,
+                         trim, trim * CLOCKSYNC_PPM_PER_TRIM);
+            if (clock.driftKnown()) {
+                std::fprintf(stderr, ", drift %+.1f +- %.1f ppm", clock.driftPpm(), clock.driftErrorPpm());
+            }
+            if (game.running && game.locked && game.errors > 0) {
+                std::fprintf(stderr, " | tick %u, error %+.1f ms (rms %.1f), nudged %+ld ms", game.tick, game.error,
+                             std::sqrt(game.error_squares / game.errors), game.nudged);
+                game.error_squares = 0;
+                game.errors = 0;
+                game.nudged = 0;
+            }
+            std::fprintf(stderr, "\n");
+        }
+    } catch (const std::exception& e) {
+        std::fprintf(stderr, "conductor: %s\n", e.what());
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,51 @@
+#!/bin/bash
+
+# Memory report for a firmware build: flash (.text) and RAM (.data, .bss) use.
+# With a git revision as second argument, that revision is built in a temporary
+# worktree and both reports are printed side by side.
+#
+#   tools/size_report.sh [env] [base-revision]
+#   tools/size_report.sh uno HEAD~1
+
+ENV=${1:-uno}
+BASE=$2
+ROOT=$(git rev-parse --show-toplevel) || exit 1
+
+# avr-size from PATH, or the one PlatformIO installed with the toolchain
+SIZE=$(command -v avr-size || echo "$HOME/.platformio/packages/toolchain-atmelavr/bin/avr-size")
+if [ ! -x "$SIZE" ]; then
+    echo "Error: avr-size not found (build once with 'pio run' to install the toolchain)"
+    exit 1
+fi
+
+# Prints ".text .data .bss" of the env built in directory $1
+sections() {
+    pio run -s -d "$1" -e "$ENV" > /dev/null || return 1
+    "$SIZE" -A "$1/.pio/build/$ENV/firmware.elf" |
+        awk '$1 == ".text" { t = $2 } $1 == ".data" { d = $2 } $1 == ".bss" { b = $2 }
+             END { print t + 0, d + 0, b + 0 }'
+}
+
+AFTER=$(sections "$ROOT") || { echo "Error: build of $ENV failed"; exit 1; }
+
+if [ -z "$BASE" ]; then
+    read -r TEXT DATA BSS <<< "$AFTER"
+    printf "%-6s %8s\n" "" "$ENV"
+    printf "%-6s %8d\n" ".text" "$TEXT" ".data" "$DATA" ".bss" "$BSS"
+    printf "%-6s %8d of 2048 bytes\n" "RAM" $((DATA + BSS))
+    exit 0
+fi
+
+WORKTREE=$(mktemp -d)
+trap 'git -C "$ROOT" worktree remove --force "$WORKTREE"' EXIT
+git -C "$ROOT" worktree add -q --detach "$WORKTREE" "$BASE" || exit 1
+BEFORE=$(sections "$WORKTREE") || { echo "Error: build of $BASE failed"; exit 1; }
+
+read -r TEXT0 DATA0 BSS0 <<< "$BEFORE"
+read -r TEXT1 DATA1 BSS1 <<< "$AFTER"
+printf "%-6s %10s %10s %8s\n" "" "$BASE" "working" "change"
+printf "%-6s %10d %10d %+8d\n" \
+    ".text" "$TEXT0" "$TEXT1" $((TEXT1 - TEXT0)) \
+    ".data" "$DATA0" "$DATA1" $((DATA1 - DATA0)) \
+    ".bss" "$BSS0" "$BSS1" $((BSS1 - BSS0)) \
+    "RAM" $((DATA0 + BSS0)) $((DATA1 + BSS1)) $((DATA1 + BSS1 - DATA0 - BSS0))
@@ -0,0 +1,159 @@
+// Decodes the firmware's binary telemetry (uno_telemetry build) into CSV or JSON lines.
+//
+//   telemetry_decode [--json] [--baud N] [--text] <serial device | pty | file | ->
+//
+// Text printed by the firmware between frames (menus, statistics) is dropped,
+// or copied to stderr with --text.
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "cobs.hpp"
+#include "serial_port.hpp"
+#include "telemetry_protocol.h"
+
+using namespace audiosurf;
+
+namespace {
+
+struct Options {
+    std::string path;
+    int baud = 9600;
+    bool json = false;
+    bool text = false;
+};
+
+void usage() {
+    std::fprintf(stderr, "usage: telemetry_decode [--json] [--baud N] [--text] <device|file|->\n");
+    std::exit(2);
+}
+
+Options parseArgs(int argc, char** argv) {
+    Options options;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--json") options.json = true;
+        else if (arg == "--csv") options.json = false;
+        else if (arg == "--text") options.text = true;
+        else if (arg == "--baud" && i + 1 < argc) options.baud = std::atoi(argv[++i]);
+        else if (!arg.empty() && (arg[0] != '-' || arg == "-") && options.path.empty()) options.path = arg;
+        else usage();
+    }
+    if (options.path.empty()) usage();
+    return options;
+}
+
+const char* typeName(uint8_t type) {
+    switch (type) {
+        case TELEMETRY_TICK: return "tick";
+        case TELEMETRY_COLLISION: return "collision";
+        case TELEMETRY_LEVEL_UP: return "level_up";
+        case TELEMETRY_GAME_OVER: return "game_over";
+        default: return nullptr;
+    }
+}
+
+// Every record becomes one row; fields a record doesn't carry stay empty (CSV) or absent (JSON)
+struct Row {
+    const char* type;
+    uint64_t time;
+    std::vector<std::pair<const char*, unsigned long>> fields;
+};
+
+const char* const kColumns[] = {"level", "lives", "ship", "entities", "score", "dodged", "kind", "period_ms"};
+
+void printRow(const Row& row, bool json) {
+    if (json) {
+        std::printf("{\"type\":\"%s\",\"time_ms\":%llu", row.type, static_cast<unsigned long long>(row.time));
+        for (const auto& field : row.fields) std::printf(",\"%s\":%lu", field.first, field.second);
+        std::printf("}\n");
+        return;
+    }
+    std::printf("%llu,%s", static_cast<unsigned long long>(row.time), row.type);
+    for (const char* column : kColumns) {
+        std::printf(",");
+        for (const auto& field : row.fields) {
+            if (std::strcmp(field.first, column) == 0) std::printf("%lu", field.second);
+        }
+    }
+    std::printf("\n");
+}
+
+bool decodeRecord(const std::vector<uint8_t>& record, TimestampUnwrapper& clock, Row& row) {
+    if (record.size() < TELEMETRY_HEADER_SIZE) return false;
+    row.type = typeName(record[0]);
+    if (row.type == nullptr) return false;
+    row.time = clock(readU16(&record[1]));
+    row.fields.clear();
+
+    const uint8_t* p = record.data() + TELEMETRY_HEADER_SIZE;
+    size_t size = record.size() - TELEMETRY_HEADER_SIZE;
+    switch (record[0]) {
+        case TELEMETRY_TICK:
+            if (size != TELEMETRY_TICK_SIZE) return false;
+            row.fields = {{"level", p[0]}, {"lives", p[1]}, {"ship", p[2]}, {"entities", p[3]},
+                          {"score", readU16(p + 4)}, {"dodged", readU32(p + 6)}};
+            return true;
+        case TELEMETRY_COLLISION:
+            if (size != TELEMETRY_COLLISION_SIZE) return false;
+            row.fields = {{"lives", p[0]}, {"ship", p[1]}, {"kind", p[2]}};
+            return true;
+        case TELEMETRY_LEVEL_UP:
+            if (size != TELEMETRY_LEVEL_UP_SIZE) return false;
+            row.fields = {{"level", p[0]}, {"period_ms", readU16(p + 1)}};
+            return true;
+        case TELEMETRY_GAME_OVER:
+            if (size != TELEMETRY_GAME_OVER_SIZE) return false;
+            row.fields = {{"level", p[0]}, {"score", readU16(p + 1)}, {"dodged", readU32(p + 3)}};
+            return true;
+    }
+    return false;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    Options options = parseArgs(argc, argv);
+
+    try {
+        SerialPort port(options.path, options.baud);
+        FrameReader reader;
+        TimestampUnwrapper clock;
+        Row row;
+        uint64_t unknown = 0;
+
+        if (!options.json) {
+            std::printf("time_ms,type");
+            for (const char* column : kColumns) std::printf(",%s", column);
+            std::printf("\n");
+        }
+
+        uint8_t buffer[4096];
+        while (true) {
+            ssize_t n = port.read(buffer, sizeof(buffer));
+            if (n <= 0) break;
+            reader.feed(
+                buffer, static_cast<size_t>(n),
+                [&](const std::vector<uint8_t>& record) {
+                    if (decodeRecord(record, clock, row)) printRow(row, options.json);
+                    else unknown++;
+                },
+                [&](const std::vector<uint8_t>& text) {
+                    if (options.text) std::fwrite(text.data(), 1, text.size(), stderr);
+                });
+            std::fflush(stdout);
+        }
+
+        std::fprintf(stderr, "telemetry_decode: %llu records, %llu unknown, %llu non-frame chunks\n",
+                     static_cast<unsigned long long>(reader.frames()),
+                     static_cast<unsigned long long>(unknown),
+                     static_cast<unsigned long long>(reader.rejected()));
+    } catch (const std::exception& e) {
+        std::fprintf(stderr, "telemetry_decode: %s\n", e.what());
+        return 1;
+    }
+    return 0;
+}